@@ -0,0 +1,47 @@
+#include "generators.hxx"
+#include "measure.hxx"
+#include "../hexus/hexus.hxx"
+
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace ad::hexus;
+
+// Tiles random boards of a growing number of cells with pieces cut from them
+int main (int argc, char ** argv)
+{
+  unsigned max_size = 120, puzzles = 5;
+  ad::bench::read_arguments(argc, argv, max_size, puzzles);
+
+  ad::bench::report report ("hexus", "nodes");
+  for (unsigned n = 12; n <= max_size; n += 6)
+    {
+      unsigned solved = 0;
+      std::uint64_t total_nodes = 0;
+      double seconds = 0;
+      for (unsigned seed = 0; seed < puzzles; ++seed)
+	{
+	  ad::bench::hexus_puzzle text = ad::bench::hexus(16, 16, n, n * 1000 + seed);
+	  std::istringstream board_is (text.board), pieces_is (text.pieces);
+	  board b;
+	  board_is >> b;
+	  std::map<char, piece> pieces;
+	  read_pieces(pieces_is, pieces);
+
+	  ad::bench::stopwatch watch;
+	  placement_table piece_coverage;
+	  piece_coverage.build(place_pieces(b, pieces));
+	  search_options options;
+	  options.neighbours = neighbours(b);
+	  options.table_bytes = 64 << 20;
+	  std::vector<int> chosen;
+	  search_stats stats;
+	  solved += solve(piece_coverage, b.cells.size(), chosen, options, stats);
+	  seconds += watch.seconds();
+	  total_nodes += stats.nodes;
+	}
+      report.row(std::to_string(n) + " cells", solved, puzzles, seconds, total_nodes);
+    }
+}
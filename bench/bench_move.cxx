@@ -0,0 +1,41 @@
+#include "generators.hxx"
+#include "measure.hxx"
+#include "../move/move.hxx"
+
+#include <sstream>
+#include <string>
+
+using namespace ad::move;
+
+// Searches random 6 by 6 boards breadth first, with a growing number of dots
+int main (int argc, char ** argv)
+{
+  unsigned max_size = 4, puzzles = 5;
+  ad::bench::read_arguments (argc, argv, max_size, puzzles);
+
+  ad::bench::report report ("move", "expanded");
+  for (unsigned k=1; k <= max_size; ++k)
+    {
+      unsigned solved = 0;
+      std::uint64_t expanded = 0;
+      double seconds = 0;
+      for (unsigned seed=0; seed < puzzles; ++seed)
+	{
+	  std::istringstream is (ad::bench::move (6, 6, k, 0.15, k * 1000 + seed));
+	  board b;
+	  gamestate gs;
+	  is >> b >> gs;
+
+	  ad::bench::stopwatch watch;
+	  codec c (b, gs);
+	  if (c.fits() == false)
+	    continue;
+	  slide_table t (b, c);
+	  search_result r = solve_bfs(c.encode(gs), c, t);
+	  seconds += watch.seconds();
+	  solved += r.found;
+	  expanded += r.expanded;
+	}
+      report.row(std::to_string(k) + " dots", solved, puzzles, seconds, expanded);
+    }
+}
@@ -0,0 +1,34 @@
+#include "generators.hxx"
+#include "measure.hxx"
+#include "../nonogram/nonogram.hxx"
+
+#include <sstream>
+#include <string>
+
+// Solves random n by n nonograms of growing n
+int main (int argc, char ** argv)
+{
+  unsigned max_size = 50, puzzles = 5;
+  ad::bench::read_arguments (argc, argv, max_size, puzzles);
+
+  ad::bench::report report ("nonogram", "line solves");
+  for (unsigned n=5; n <= max_size; n += n < 30 ? 5 : 10)
+  {
+    unsigned solved = 0;
+    std::uint64_t line_solves = 0;
+    double seconds = 0;
+    for (unsigned seed=0; seed < puzzles; ++seed)
+    {
+      std::istringstream is (ad::bench::nonogram (n, 0.55, n * 1000 + seed));
+      ad::nonogram ng;
+      is >> ng;
+
+      ad::bench::stopwatch watch;
+      if (ng.solve() != ad::nonogram::none)
+        ++ solved;
+      seconds += watch.seconds();
+      line_solves += ng.line_solve_count();
+    }
+    report.row (std::to_string (n) + "x" + std::to_string (n), solved, puzzles, seconds, line_solves);
+  }
+}
@@ -0,0 +1,35 @@
+#include "generators.hxx"
+#include "measure.hxx"
+#include "../strata/strata.hxx"
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Peels random n by n grids of four colours, doubling n
+int main (int argc, char ** argv)
+{
+	unsigned max_size = 3200, puzzles = 3;
+	ad::bench::read_arguments(argc, argv, max_size, puzzles);
+
+	ad::bench::report report ("strata", "cells");
+	for (unsigned n = 100; n <= max_size; n *= 2)
+	{
+		unsigned solved = 0;
+		std::uint64_t cells = 0;
+		double seconds = 0;
+		for (unsigned seed = 0; seed < puzzles; ++seed)
+		{
+			std::istringstream is (ad::bench::strata(n, n, 4, n, n * 1000 + seed));
+			ad::strata::puzzle p;
+			is >> p;
+
+			ad::bench::stopwatch watch;
+			std::vector<ad::strata::step> steps;
+			solved += ad::strata::solve(p, steps);
+			seconds += watch.seconds();
+			cells += p.grid.size();
+		}
+		report.row(std::to_string(n) + "x" + std::to_string(n), solved, puzzles, seconds, cells);
+	}
+}
@@ -0,0 +1,38 @@
+#include "generators.hxx"
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+// Writes one generated puzzle to stdout, for feeding to the solvers:
+//
+//   generate nonogram N [DENSITY] [SEED]
+//   generate move HEIGHT WIDTH DOTS [WALLS] [SEED]
+//   generate strata ROWS COLUMNS COLOURS [HOLES] [SEED]
+//   generate hexus ROWS COLUMNS CELLS [SEED]
+//   generate hexus-pieces ROWS COLUMNS CELLS [SEED]
+//
+// hexus writes the board and hexus-pieces the pieces for the same arguments,
+// for hexus -p.
+int main (int argc, char ** argv)
+{
+  std::string kind = argc > 1 ? argv[1] : "";
+  auto arg = [&] (int i, double otherwise) { return i < argc ? std::atof (argv[i]) : otherwise; };
+  auto seed = [&] (int i) { return i < argc ? std::strtoull (argv[i], nullptr, 10) : 1; };
+
+  if (kind == "nonogram" && argc > 2)
+    std::cout << ad::bench::nonogram (arg (2, 0), arg (3, 0.55), seed (4));
+  else if (kind == "move" && argc > 4)
+    std::cout << ad::bench::move (arg (2, 0), arg (3, 0), arg (4, 0), arg (5, 0.15), seed (6));
+  else if (kind == "strata" && argc > 4)
+    std::cout << ad::bench::strata (arg (2, 0), arg (3, 0), arg (4, 0), arg (5, 0), seed (6));
+  else if (kind == "hexus" && argc > 4)
+    std::cout << ad::bench::hexus (arg (2, 0), arg (3, 0), arg (4, 0), seed (5)).board;
+  else if (kind == "hexus-pieces" && argc > 4)
+    std::cout << ad::bench::hexus (arg (2, 0), arg (3, 0), arg (4, 0), seed (5)).pieces;
+  else
+  {
+    std::cerr << "usage: generate nonogram|move|strata|hexus|hexus-pieces ARGS...\n";
+    return 1;
+  }
+}
@@ -0,0 +1,237 @@
+#ifndef AD_BENCH_GENERATORS_HXX
+#define AD_BENCH_GENERATORS_HXX
+
+#include <algorithm>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Puzzle generators for the benchmarks.  Each writes a puzzle in the format
+// its solver reads, and depends only on its arguments and seed, so the same
+// puzzles come out on every machine.
+namespace ad::bench
+{
+  // splitmix64: the distributions in <random> differ between standard
+  // libraries, so the generators draw from this instead.
+  class rng
+  {
+    std::uint64_t state;
+
+  public:
+    explicit rng (std::uint64_t seed)
+      : state (seed)
+    {}
+
+    std::uint64_t next ()
+    {
+      std::uint64_t z = (state += 0x9e3779b97f4a7c15);
+      z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+      z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+      return z ^ (z >> 31);
+    }
+
+    // Uniform in [0, n)
+    std::uint64_t below (std::uint64_t n)
+    { return next() % n; }
+
+    bool chance (double p)
+    { return (next() >> 11) * 0x1.0p-53 < p; }
+
+    template <typename T>
+    void shuffle (std::vector<T> & v)
+    {
+      for (std::size_t i = v.size(); i > 1; --i)
+        std::swap (v[i-1], v[below (i)]);
+    }
+  };
+
+  // An n by n nonogram with each cell black with probability density.  Its
+  // hints come from a random picture, so it has at least one solution.
+  std::string nonogram (unsigned n, double density, std::uint64_t seed)
+  {
+    rng r (seed);
+    std::vector<bool> picture (n * n);
+    for (std::size_t i=0; i < picture.size(); ++i)
+      picture[i] = r.chance (density);
+
+    std::ostringstream os;
+    auto hints = [&] (unsigned line, bool column)
+    {
+      unsigned run = 0;
+      for (unsigned i=0; i < n; ++i)
+      {
+        if (column ? picture[i * n + line] : picture[line * n + i])
+          ++ run;
+        else if (run != 0)
+        {
+          os << run << ' ';
+          run = 0;
+        }
+      }
+      if (run != 0)
+        os << run << ' ';
+      os << "0\n";
+    };
+
+    os << n << ' ' << n << "\n\n";
+    for (unsigned w=0; w < n; ++w)
+      hints (w, true);
+    os << '\n';
+    for (unsigned h=0; h < n; ++h)
+      hints (h, false);
+    return os.str();
+  }
+
+  // A height by width Move board with each square a wall with probability
+  // walls, and k dots of four colours, each with a goal square.  Many have
+  // no solution.
+  std::string move (int height, int width, int k, double walls, std::uint64_t seed)
+  {
+    rng r (seed);
+    std::string grid (height * width, '.');
+    std::vector<int> open;
+    for (int i=0; i < height * width; ++i)
+      if (r.chance (walls))
+        grid[i] = 'x';
+      else
+        open.push_back (i);
+    k = std::min<int> (k, open.size());
+
+    static char const colours[] = "rgyb";
+    r.shuffle (open);
+    for (int d=0; d < k; ++d)
+      grid[open[d]] = colours[d % 4];
+    r.shuffle (open);
+
+    std::ostringstream os;
+    os << height << ' ' << width << '\n';
+    for (int h=0; h < height; ++h)
+      os << grid.substr (h * width, width) << '\n';
+    os << k << '\n';
+    for (int d=0; d < k; ++d)
+      os << open[d] / width << ' ' << open[d] % width << ' ' << colours[d % 4] << '\n';
+    return os.str();
+  }
+
+  // A Strata grid made by laying a ribbon of one of n_colours colours over
+  // every row and column in a random order, then knocking out holes cells.
+  std::string strata (unsigned rows, unsigned cols, unsigned n_colours, unsigned holes, std::uint64_t seed)
+  {
+    rng r (seed);
+    std::string grid (rows * cols, '.');
+
+    std::vector<unsigned> lines (rows + cols);
+    for (unsigned i=0; i < lines.size(); ++i)
+      lines[i] = i;
+    r.shuffle (lines);
+    for (unsigned line : lines)
+    {
+      char colour = 'a' + r.below (n_colours);
+      if (line < rows)
+        std::fill (grid.begin() + line * cols, grid.begin() + (line + 1) * cols, colour);
+      else
+        for (unsigned row=0; row < rows; ++row)
+          grid[row * cols + line - rows] = colour;
+    }
+    for (unsigned h=0; h < holes; ++h)
+      grid[r.below (grid.size())] = '.';
+
+    std::ostringstream os;
+    os << rows << ' ' << cols << '\n';
+    for (unsigned row=0; row < rows; ++row)
+      os << grid.substr (row * cols, cols) << '\n';
+    return os.str();
+  }
+
+  // A connected Hexus board of n_cells cells within rows by columns, and a
+  // set of pieces cut from it, so it can be tiled.  Pieces are grown to four
+  // to six cells where there is room, and named from a set of 60 letters and
+  // digits, so boards much over 240 cells run out of names.  The board and
+  // the pieces are drawn on the same grid.
+  struct hexus_puzzle
+  {
+    std::string board;
+    std::string pieces;
+  };
+
+  hexus_puzzle hexus (int rows, int columns, int n_cells, std::uint64_t seed)
+  {
+    rng r (seed);
+    n_cells = std::min (n_cells, rows * columns);
+
+    // The six neighbours of a cell on the offset grid the solver reads
+    auto neighbours = [&] (int cell)
+    {
+      int row = cell / columns, col = cell % columns;
+      int shift = row % 2 == 0 ? 0 : -1;
+      std::pair<int,int> const steps[] = {{0, -1}, {0, 1}, {-1, shift}, {-1, shift + 1},
+                                          {1, shift}, {1, shift + 1}};
+      std::vector<int> result;
+      for (auto const & s : steps)
+      {
+        int rr = row + s.first, cc = col + s.second;
+        if (rr >= 0 && rr < rows && cc >= 0 && cc < columns)
+          result.push_back (rr * columns + cc);
+      }
+      return result;
+    };
+
+    // Grow the board from the middle
+    std::vector<bool> on_board (rows * columns, false);
+    std::vector<int> cells {rows / 2 * columns + columns / 2};
+    on_board[cells[0]] = true;
+    while (int (cells.size()) < n_cells)
+    {
+      std::vector<int> next = neighbours (cells[r.below (cells.size())]);
+      int cell = next[r.below (next.size())];
+      if (on_board[cell] == false)
+      {
+        on_board[cell] = true;
+        cells.push_back (cell);
+      }
+    }
+
+    // Cut it into pieces, each grown from the lowest cell not yet taken
+    static char const names[] = "ABCDEFGHIJKLMNOPQRSTUVWYZabcdefghijklmnopqrstuvwyz0123456789";
+    std::string drawing (rows * columns, '.');
+    int n_pieces = 0;
+    for (int start=0; start < rows * columns; ++start)
+    {
+      if (on_board[start] == false || drawing[start] != '.')
+        continue;
+      char name = names[n_pieces++ % (sizeof (names) - 1)];
+      std::vector<int> piece {start};
+      drawing[start] = name;
+      int size = 4 + r.below (3);
+      for (int tries=0; int (piece.size()) < size && tries < 50; ++tries)
+      {
+        std::vector<int> next = neighbours (piece[r.below (piece.size())]);
+        int cell = next[r.below (next.size())];
+        if (on_board[cell] && drawing[cell] == '.')
+        {
+          drawing[cell] = name;
+          piece.push_back (cell);
+        }
+      }
+    }
+
+    hexus_puzzle p;
+    std::ostringstream board, pieces;
+    board << rows << ' ' << columns << '\n';
+    pieces << rows << ' ' << columns << '\n';
+    for (int row=0; row < rows; ++row)
+    {
+      for (int col=0; col < columns; ++col)
+        board << (on_board[row * columns + col] ? '.' : 'x');
+      board << '\n';
+      pieces << drawing.substr (row * columns, columns) << '\n';
+    }
+    p.board = board.str();
+    p.pieces = pieces.str();
+    return p;
+  }
+}
+
+#endif
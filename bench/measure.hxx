@@ -0,0 +1,67 @@
+#ifndef AD_BENCH_MEASURE_HXX
+#define AD_BENCH_MEASURE_HXX
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include <sys/resource.h>
+
+namespace ad::bench
+{
+  // Peak resident set size of the process so far, in KiB.  It never falls,
+  // so the sizes are run smallest first and each row shows the peak up to
+  // and including that size.
+  long peak_rss_kib ()
+  {
+    rusage usage;
+    getrusage (RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+  }
+
+  class stopwatch
+  {
+    using clock = std::chrono::steady_clock;
+    clock::time_point start = clock::now();
+
+  public:
+    double seconds () const
+    { return std::chrono::duration<double> (clock::now() - start).count(); }
+  };
+
+  // One line of a benchmark's table: the size, the puzzles solved, the wall
+  // time, a count of the solver's work and its rate, and the peak RSS.
+  class report
+  {
+  public:
+    // work names what is counted, such as "line solves"
+    report (char const * title, char const * work)
+    {
+      std::printf ("%s\n%-12s %8s %8s %12s %14s %12s\n", title, "size", "solved", "time s",
+                   work, (std::string (work) + "/s").c_str(), "peak KiB");
+    }
+
+    void row (std::string const & size, unsigned solved, unsigned puzzles, double seconds,
+              std::uint64_t count)
+    {
+      std::string ratio = std::to_string (solved) + "/" + std::to_string (puzzles);
+      std::printf ("%-12s %8s %8.3f %12llu %14.0f %12ld\n", size.c_str(), ratio.c_str(), seconds,
+                   (unsigned long long) count, seconds > 0 ? count / seconds : 0.0, peak_rss_kib());
+      std::fflush (stdout);
+    }
+  };
+
+  // The benchmarks take the largest size to run, and the number of puzzles
+  // at each size, in place of their defaults
+  void read_arguments (int argc, char ** argv, unsigned & max_size, unsigned & puzzles)
+  {
+    if (argc > 1)
+      max_size = std::atoi (argv[1]);
+    if (argc > 2)
+      puzzles = std::atoi (argv[2]);
+  }
+}
+
+#endif
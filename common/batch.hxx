@@ -0,0 +1,74 @@
+#ifndef AD_BATCH_HXX
+#define AD_BATCH_HXX
+
+#include "scanner.hxx"
+#include "thread_pool.hxx"
+
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace ad
+{
+  // Solves a stream of puzzles, one after another in the input.  Up to chunk
+  // puzzles are read at a time with in >> puzzle, solved together on the
+  // pool with solve(puzzle, os), and then written out in input order, each
+  // after a line with its number and how long it took.  Prints the number of
+  // puzzles and the rate they were solved at to stderr.  Returns false if
+  // the input ends partway through a puzzle.
+  template <typename Puzzle, typename Solve>
+  bool run_batch (scanner & in, thread_pool & pool, std::ostream & out, Solve solve,
+                  std::size_t chunk = 1024)
+  {
+    using clock = std::chrono::steady_clock;
+
+    auto start = clock::now();
+    std::size_t n_puzzles = 0;
+    bool ok = true;
+
+    std::vector<Puzzle> puzzles;
+    std::vector<std::string> results;
+    std::vector<double> micros;
+    while (ok && in.at_end() == false)
+    {
+      puzzles.clear();
+      while (puzzles.size() != chunk && in.at_end() == false)
+      {
+        puzzles.emplace_back();
+        if (! (in >> puzzles.back()))
+        {
+          puzzles.pop_back();
+          ok = false;
+          break;
+        }
+      }
+
+      results.assign (puzzles.size(), std::string());
+      micros.assign (puzzles.size(), 0);
+      pool.parallel_for (puzzles.size(), [&] (std::size_t i)
+      {
+        auto t0 = clock::now();
+        std::ostringstream os;
+        solve (puzzles[i], os);
+        results[i] = os.str();
+        micros[i] = std::chrono::duration<double, std::micro> (clock::now() - t0).count();
+      });
+
+      for (std::size_t i=0; i < puzzles.size(); ++i)
+        out << "puzzle " << n_puzzles + i + 1 << ": " << int (micros[i]) << " us\n" << results[i];
+      n_puzzles += puzzles.size();
+    }
+
+    double seconds = std::chrono::duration<double> (clock::now() - start).count();
+    std::cerr << n_puzzles << " puzzles in " << seconds << " s ("
+              << (seconds > 0 ? n_puzzles / seconds : 0) << " puzzles/s)\n";
+    if (ok == false)
+      std::cerr << "bad input after puzzle " << n_puzzles << ".\n";
+    return ok;
+  }
+}
+
+#endif
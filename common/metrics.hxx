@@ -0,0 +1,210 @@
+#ifndef AD_METRICS_HXX
+#define AD_METRICS_HXX
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Counters and timers for seeing where a search spends its time.  They only
+// count when the program is built with AD_METRICS defined (the CMake option
+// PUZZLES_METRICS); otherwise every update is an empty inline function, so
+// the solvers call them unconditionally and pay nothing, and they all read
+// as zero.
+namespace ad
+{
+#ifdef AD_METRICS
+  constexpr bool metrics_enabled = true;
+#else
+  constexpr bool metrics_enabled = false;
+#endif
+
+  // A count, or the largest of a series of values
+  class counter
+  {
+    std::uint64_t n = 0;
+
+  public:
+    void operator ++ ()
+    {
+      if constexpr (metrics_enabled)
+        ++ n;
+    }
+
+    void operator += (std::uint64_t k)
+    {
+      if constexpr (metrics_enabled)
+        n += k;
+    }
+
+    void at_least (std::uint64_t k)
+    {
+      if constexpr (metrics_enabled)
+        n = std::max (n, k);
+    }
+
+    std::uint64_t value () const
+    { return n; }
+  };
+
+  // Counts by a small index, such as a depth in a search tree
+  class histogram
+  {
+    std::vector<std::uint64_t> counts;
+
+  public:
+    void add (std::size_t i, std::uint64_t k = 1)
+    {
+      if constexpr (metrics_enabled)
+      {
+        if (counts.size() <= i)
+          counts.resize (i + 1, 0);
+        counts[i] += k;
+      }
+    }
+
+    // Counts v in bucket 0 if it is 0, or else bucket b, where v has b
+    // significant bits: 1, 2-3, 4-7 and so on
+    void add_log2 (std::uint64_t v)
+    { add (v == 0 ? 0 : 64 - __builtin_clzll (v)); }
+
+    histogram & operator += (histogram const & h)
+    {
+      for (std::size_t i=0; i < h.counts.size(); ++i)
+        add (i, h.counts[i]);
+      return *this;
+    }
+
+    std::vector<std::uint64_t> const & values () const
+    { return counts; }
+  };
+
+  // Time spent in some phase, summed over every time it was entered
+  class timer
+  {
+    double total = 0;
+    friend class timed;
+
+  public:
+    double seconds () const
+    { return total; }
+  };
+
+  // Adds the time from its construction to its destruction to a timer
+  class timed
+  {
+    using clock = std::chrono::steady_clock;
+    timer & t;
+    clock::time_point start;
+
+  public:
+    explicit timed (timer & t)
+      : t (t)
+    {
+      if constexpr (metrics_enabled)
+        start = clock::now();
+    }
+
+    timed (timed const &) = delete;
+    timed & operator = (timed const &) = delete;
+
+    ~timed ()
+    {
+      if constexpr (metrics_enabled)
+        t.total += std::chrono::duration<double> (clock::now() - start).count();
+    }
+  };
+
+  // Writes metrics as one JSON object, member by member; nested objects are
+  // opened with begin() and closed with end().  The object starts with
+  // "metrics": false if the counters were compiled out.
+  class json_writer
+  {
+    std::ostream & os;
+    bool first = true;
+    int depth = 1;
+
+    void key (char const * name)
+    {
+      os << (first ? "" : ",") << '\n' << std::string (2 * depth, ' ') << '"' << name << "\": ";
+      first = false;
+    }
+
+  public:
+    explicit json_writer (std::ostream & os)
+      : os (os)
+    {
+      os << '{';
+      field ("metrics", metrics_enabled);
+    }
+
+    json_writer (json_writer const &) = delete;
+    json_writer & operator = (json_writer const &) = delete;
+
+    ~json_writer ()
+    {
+      while (depth > 1)
+        end();
+      os << "\n}\n";
+    }
+
+    json_writer & begin (char const * name)
+    {
+      key (name);
+      os << '{';
+      first = true;
+      ++ depth;
+      return *this;
+    }
+
+    json_writer & end ()
+    {
+      -- depth;
+      os << '\n' << std::string (2 * depth, ' ') << '}';
+      first = false;
+      return *this;
+    }
+
+    json_writer & field (char const * name, bool v)
+    {
+      key (name);
+      os << (v ? "true" : "false");
+      return *this;
+    }
+
+    json_writer & field (char const * name, std::uint64_t v)
+    {
+      key (name);
+      os << v;
+      return *this;
+    }
+
+    json_writer & field (char const * name, double v)
+    {
+      key (name);
+      os << v;
+      return *this;
+    }
+
+    json_writer & field (char const * name, counter const & c)
+    { return field (name, c.value()); }
+
+    json_writer & field (char const * name, timer const & t)
+    { return field (name, t.seconds()); }
+
+    json_writer & field (char const * name, histogram const & h)
+    {
+      key (name);
+      os << '[';
+      for (std::size_t i=0; i < h.values().size(); ++i)
+        os << (i == 0 ? "" : ", ") << h.values()[i];
+      os << ']';
+      return *this;
+    }
+  };
+}
+
+#endif
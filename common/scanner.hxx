@@ -0,0 +1,171 @@
+#ifndef AD_SCANNER_HXX
+#define AD_SCANNER_HXX
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ad
+{
+  // Reads numbers and characters from a block of memory: a file mapped in,
+  // or everything on standard input.  It stands in for the formatted input
+  // of std::istream, skipping whitespace before each item and failing on a
+  // malformed one, so the puzzles' operator >> work on either; but it has no
+  // locale, sentry or virtual calls to pay for on every item.
+  class scanner
+  {
+    std::vector<char> buffer;
+    void * map = MAP_FAILED;
+    std::size_t map_size = 0;
+
+    char const * pos = nullptr;
+    char const * end = nullptr;
+    bool failed = false;
+
+    static bool space (char c)
+    { return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' || c == '\f'; }
+
+    void skip_space ()
+    {
+      while (pos != end && space (*pos))
+        ++ pos;
+    }
+
+    void unmap ()
+    {
+      if (map != MAP_FAILED)
+        munmap (map, map_size);
+      map = MAP_FAILED;
+    }
+
+    template <typename T>
+    scanner & read_integer (T & value)
+    {
+      skip_space();
+      bool negative = pos != end && *pos == '-';
+      if (negative || (pos != end && *pos == '+'))
+        ++ pos;
+      if (pos == end || *pos < '0' || *pos > '9')
+      {
+        // As std::istream does, so a loop reading up to a 0 stops
+        value = 0;
+        failed = true;
+        return *this;
+      }
+      T v = 0;
+      for (; pos != end && *pos >= '0' && *pos <= '9'; ++pos)
+        v = v * 10 + (*pos - '0');
+      value = negative ? -v : v;
+      return *this;
+    }
+
+  public:
+    scanner () = default;
+    scanner (scanner const &) = delete;
+    scanner & operator = (scanner const &) = delete;
+
+    ~scanner ()
+    { unmap(); }
+
+    // Maps a file.  Returns false if it cannot be read.
+    bool open (std::string const & path)
+    {
+      unmap();
+      int fd = ::open (path.c_str(), O_RDONLY);
+      if (fd < 0)
+        return false;
+      struct stat st;
+      bool ok = fstat (fd, &st) == 0;
+      if (ok && st.st_size > 0)
+      {
+        map_size = st.st_size;
+        map = mmap (nullptr, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ok = map != MAP_FAILED;
+      }
+      ::close (fd);
+
+      pos = ok && map != MAP_FAILED ? static_cast<char const *> (map) : nullptr;
+      end = pos == nullptr ? nullptr : pos + map_size;
+      failed = ok == false;
+      return ok;
+    }
+
+    // Reads everything from a file descriptor, such as standard input, which
+    // may be a pipe.
+    bool read_all (int fd)
+    {
+      unmap();
+      buffer.clear();
+      std::size_t size = 0;
+      while (true)
+      {
+        buffer.resize (size + (1 << 16));
+        ssize_t n = ::read (fd, buffer.data() + size, buffer.size() - size);
+        if (n < 0)
+        {
+          failed = true;
+          return false;
+        }
+        if (n == 0)
+          break;
+        size += n;
+      }
+      buffer.resize (size);
+      pos = buffer.data();
+      end = pos + size;
+      failed = false;
+      return true;
+    }
+
+    // Reads from a copy of text, such as one request to a server
+    void assign (std::string const & text)
+    {
+      unmap();
+      buffer.assign (text.begin(), text.end());
+      pos = buffer.data();
+      end = pos + buffer.size();
+      failed = false;
+    }
+
+    explicit operator bool () const
+    { return failed == false; }
+
+    bool fail () const
+    { return failed; }
+
+    // Whether only whitespace is left
+    bool at_end ()
+    {
+      skip_space();
+      return pos == end;
+    }
+
+    scanner & operator >> (int & v)      { return read_integer (v); }
+    scanner & operator >> (unsigned & v) { return read_integer (v); }
+
+    scanner & operator >> (char & c)
+    {
+      skip_space();
+      if (pos == end)
+      {
+        c = '\0';
+        failed = true;
+      }
+      else
+        c = *pos++;
+      return *this;
+    }
+
+    template <typename A, typename B>
+    scanner & operator >> (std::pair<A,B> & p)
+    { return *this >> p.first >> p.second; }
+  };
+}
+
+#endif
@@ -0,0 +1,113 @@
+#ifndef AD_THREAD_POOL_HXX
+#define AD_THREAD_POOL_HXX
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ad
+{
+  // A fixed set of threads which run one parallel loop at a time.  The
+  // calling thread takes part in the loop, so a pool of size 1 has no
+  // workers and runs everything inline.
+  class thread_pool
+  {
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable start_cv;
+    std::condition_variable done_cv;
+
+    std::function<void(std::size_t)> task;
+    std::size_t task_size = 0;
+    std::atomic<std::size_t> next {0};
+    unsigned generation = 0;
+    unsigned running = 0;
+    bool stopping = false;
+
+    // Takes indices from the shared counter until they run out
+    void work ()
+    {
+      for (std::size_t i = next++; i < task_size; i = next++)
+        task (i);
+    }
+
+    void worker_loop ()
+    {
+      unsigned seen = 0;
+      while (true)
+      {
+        {
+          std::unique_lock<std::mutex> lock (mutex);
+          start_cv.wait (lock, [&] { return stopping || generation != seen; });
+          if (stopping)
+            return;
+          seen = generation;
+        }
+
+        work();
+
+        std::lock_guard<std::mutex> lock (mutex);
+        if (--running == 0)
+          done_cv.notify_one();
+      }
+    }
+
+  public:
+    explicit thread_pool (unsigned threads)
+    {
+      for (unsigned t=1; t < threads; ++t)
+        workers.emplace_back ([this] { worker_loop(); });
+    }
+
+    ~thread_pool ()
+    {
+      {
+        std::lock_guard<std::mutex> lock (mutex);
+        stopping = true;
+      }
+      start_cv.notify_all();
+      for (std::thread & t : workers)
+        t.join();
+    }
+
+    thread_pool (thread_pool const &) = delete;
+    thread_pool & operator = (thread_pool const &) = delete;
+
+    unsigned size () const
+    { return workers.size() + 1; }
+
+    // Calls f(i) for every i in [0, n), and returns once all calls are done.
+    void parallel_for (std::size_t n, std::function<void(std::size_t)> f)
+    {
+      if (workers.empty() || n < 2)
+      {
+        for (std::size_t i=0; i<n; ++i)
+          f (i);
+        return;
+      }
+
+      {
+        std::lock_guard<std::mutex> lock (mutex);
+        task = std::move (f);
+        task_size = n;
+        next = 0;
+        running = workers.size();
+        ++ generation;
+      }
+      start_cv.notify_all();
+
+      work();
+
+      std::unique_lock<std::mutex> lock (mutex);
+      done_cv.wait (lock, [&] { return running == 0; });
+      task = nullptr;
+    }
+  };
+}
+
+#endif
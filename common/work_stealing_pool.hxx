@@ -0,0 +1,174 @@
+#ifndef AD_WORK_STEALING_POOL_HXX
+#define AD_WORK_STEALING_POOL_HXX
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ad
+{
+  // A fixed set of threads which run a tree of tasks: run() starts one task,
+  // and any task may spawn() more.  Each thread has its own deque; it takes
+  // its newest task first, and when it has none it steals the oldest task of
+  // another thread, which is usually the largest piece of work left.  As in
+  // thread_pool, the calling thread takes part, so a pool of size 1 runs
+  // everything inline.
+  class work_stealing_pool
+  {
+  public:
+    using task = std::function<void()>;
+
+  private:
+    struct queue
+    {
+      std::mutex mutex;
+      std::deque<task> tasks;
+    };
+
+    std::vector<std::thread> workers;
+    std::vector<queue> queues;        // one per thread; the caller's is 0
+
+    std::atomic<std::size_t> pending {0};   // spawned but not finished
+    std::atomic<std::size_t> queued {0};    // spawned but not started
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool stopping = false;
+
+    // The queue of the thread running, in whichever pool it belongs to
+    static int & self ()
+    {
+      static thread_local int index = 0;
+      return index;
+    }
+
+    bool take (unsigned me, task & t)
+    {
+      {
+        queue & q = queues[me];
+        std::lock_guard<std::mutex> lock (q.mutex);
+        if (q.tasks.empty() == false)
+        {
+          t = std::move (q.tasks.back());
+          q.tasks.pop_back();
+          -- queued;
+          return true;
+        }
+      }
+      for (unsigned k=1; k < queues.size(); ++k)
+      {
+        queue & q = queues[(me + k) % queues.size()];
+        std::lock_guard<std::mutex> lock (q.mutex);
+        if (q.tasks.empty() == false)
+        {
+          t = std::move (q.tasks.front());
+          q.tasks.pop_front();
+          -- queued;
+          return true;
+        }
+      }
+      return false;
+    }
+
+    void finish (task & t)
+    {
+      t();
+      t = nullptr;
+      if (-- pending == 0)
+      {
+        std::lock_guard<std::mutex> lock (mutex);
+        cv.notify_all();
+      }
+    }
+
+    void worker_loop (unsigned me)
+    {
+      self() = me;
+      task t;
+      while (true)
+      {
+        if (take (me, t))
+        {
+          finish (t);
+          continue;
+        }
+        std::unique_lock<std::mutex> lock (mutex);
+        cv.wait (lock, [&] { return stopping || queued != 0; });
+        if (stopping)
+          return;
+      }
+    }
+
+  public:
+    explicit work_stealing_pool (unsigned threads)
+      : queues (threads < 1 ? 1 : threads)
+    {
+      for (unsigned t=1; t < queues.size(); ++t)
+        workers.emplace_back ([this, t] { worker_loop (t); });
+    }
+
+    ~work_stealing_pool ()
+    {
+      {
+        std::lock_guard<std::mutex> lock (mutex);
+        stopping = true;
+      }
+      cv.notify_all();
+      for (std::thread & t : workers)
+        t.join();
+    }
+
+    work_stealing_pool (work_stealing_pool const &) = delete;
+    work_stealing_pool & operator = (work_stealing_pool const &) = delete;
+
+    unsigned size () const
+    { return queues.size(); }
+
+    // Queues a task on the current thread.  Only to be called from a task.
+    void spawn (task t)
+    {
+      ++ pending;
+      {
+        // Counted under the queue's lock, as take() is, so a thief can never
+        // take the task before it is counted
+        queue & q = queues[self()];
+        std::lock_guard<std::mutex> lock (q.mutex);
+        q.tasks.push_back (std::move (t));
+        ++ queued;
+      }
+      std::lock_guard<std::mutex> lock (mutex);
+      cv.notify_one();
+    }
+
+    // Runs root and everything it spawns, and returns once all are done.
+    void run (task root)
+    {
+      int outer = self();
+      self() = 0;
+
+      spawn (std::move (root));
+      task t;
+      while (true)
+      {
+        if (take (0, t))
+        {
+          finish (t);
+          continue;
+        }
+        std::unique_lock<std::mutex> lock (mutex);
+        cv.wait (lock, [&] { return pending == 0 || queued != 0; });
+        if (pending == 0)
+          break;
+      }
+
+      self() = outer;
+    }
+  };
+}
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef AD_DAEMON_BOARD_CACHE_HXX
+#define AD_DAEMON_BOARD_CACHE_HXX
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+namespace ad
+{
+  // What has been built for each of the boards seen most recently, found by
+  // a signature of the board.  Entries are shared, so one evicted while a
+  // request is using it lives until the request is done.  A board missed by
+  // two threads at once is built by both, and the second copy thrown away,
+  // rather than holding the lock while it is built.
+  template <typename Value>
+  class board_cache
+  {
+    using item = std::pair<std::uint64_t, std::shared_ptr<Value>>;
+
+    std::size_t capacity;
+    std::mutex mutex;
+    std::list<item> entries;   // most recently used first
+    std::unordered_map<std::uint64_t, typename std::list<item>::iterator> index;
+
+    std::atomic<std::uint64_t> n_hits {0};
+    std::atomic<std::uint64_t> n_misses {0};
+
+  public:
+    explicit board_cache (std::size_t capacity)
+      : capacity (capacity)
+    {}
+
+    board_cache (board_cache const &) = delete;
+    board_cache & operator = (board_cache const &) = delete;
+
+    // The entry for signature, made with build() if there is none
+    template <typename Build>
+    std::shared_ptr<Value> find (std::uint64_t signature, Build build)
+    {
+      {
+        std::lock_guard<std::mutex> lock (mutex);
+        auto i = index.find (signature);
+        if (i != index.end())
+        {
+          ++ n_hits;
+          entries.splice (entries.begin(), entries, i -> second);
+          return i -> second -> second;
+        }
+      }
+      ++ n_misses;
+
+      std::shared_ptr<Value> value = build();
+      std::lock_guard<std::mutex> lock (mutex);
+      auto i = index.find (signature);
+      if (i != index.end())
+        return i -> second -> second;
+      entries.emplace_front (signature, value);
+      index[signature] = entries.begin();
+      if (entries.size() > capacity)
+      {
+        index.erase (entries.back().first);
+        entries.pop_back();
+      }
+      return value;
+    }
+
+    std::uint64_t hits () const
+    { return n_hits; }
+
+    std::uint64_t misses () const
+    { return n_misses; }
+  };
+}
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef AD_DAEMON_LATENCY_LOG_HXX
+#define AD_DAEMON_LATENCY_LOG_HXX
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace ad
+{
+  // The latencies of requests, by kind.  Each kind keeps its most recent
+  // samples in a ring, so the percentiles follow the current load and the
+  // memory stays fixed however long the server runs; the count and the
+  // largest cover every request.
+  class latency_log
+  {
+    static constexpr std::size_t ring_size = 1 << 16;
+
+    struct series
+    {
+      std::vector<double> micros;   // up to ring_size, oldest overwritten
+      std::uint64_t count = 0;
+      double max = 0;
+    };
+
+    std::mutex mutex;
+    std::map<std::string, series> kinds;
+
+    static double percentile (std::vector<double> const & sorted, double p)
+    {
+      std::size_t i = p / 100 * sorted.size();
+      return sorted[std::min (i, sorted.size() - 1)];
+    }
+
+  public:
+    void add (std::string const & kind, double micros)
+    {
+      std::lock_guard<std::mutex> lock (mutex);
+      series & s = kinds[kind];
+      if (s.micros.size() < ring_size)
+        s.micros.push_back (micros);
+      else
+        s.micros[s.count % ring_size] = micros;
+      ++ s.count;
+      s.max = std::max (s.max, micros);
+    }
+
+    // One line per kind: the requests, the 50th, 90th, 99th and 99.9th
+    // percentiles of the recent ones, and the slowest of all
+    std::string report ()
+    {
+      std::lock_guard<std::mutex> lock (mutex);
+      std::string out;
+      for (auto & [kind, s] : kinds)
+      {
+        std::vector<double> sorted (s.micros);
+        std::sort (sorted.begin(), sorted.end());
+        char line[256];
+        std::snprintf (line, sizeof (line),
+                       "%s: %llu requests, p50 %.0f us, p90 %.0f us, p99 %.0f us, p99.9 %.0f us, max %.0f us\n",
+                       kind.c_str(), (unsigned long long) s.count, percentile (sorted, 50),
+                       percentile (sorted, 90), percentile (sorted, 99), percentile (sorted, 99.9), s.max);
+        out += line;
+      }
+      return out;
+    }
+  };
+}
+
+#endif
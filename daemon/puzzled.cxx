@@ -0,0 +1,671 @@
+#include "board_cache.hxx"
+#include "latency_log.hxx"
+#include "../common/scanner.hxx"
+#include "../hexus/hexus.hxx"
+#include "../move/move.hxx"
+#include "../nonogram/nonogram.hxx"
+#include "../strata/strata.hxx"
+
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// A server which keeps the four solvers loaded, so that a stream of
+// requests pays neither for starting a process nor for rebuilding what an
+// earlier request already built.  Each request is a line
+//
+//     ID KIND BYTES
+//
+// followed by BYTES bytes of one puzzle, in the format its solver reads.
+// KIND is nonogram, move, hexus or strata, and ID is any word, which comes
+// back with the answer:
+//
+//     ID ok MICROS BYTES
+//
+// followed by BYTES bytes of what the solver prints for the puzzle, or
+// "error" and a message in place of "ok" and the answer.  MICROS is the time
+// from the request arriving to its answer being sent.  Requests are solved
+// on a pool of threads, so answers can come back in a different order from
+// the requests.  KIND stats, with no puzzle, answers at once with the
+// latency percentiles of every kind and the hits of each cache.
+
+using clock_type = std::chrono::steady_clock;
+
+//////////////
+// requests //
+//////////////
+
+// Reads requests from a file descriptor, through a buffer
+class request_reader
+{
+  static constexpr std::size_t max_line = 1024;
+
+  int fd;
+  std::vector<char> buffer = std::vector<char> (1 << 16);
+  std::size_t pos = 0, end = 0;
+
+  bool fill ()
+  {
+    ssize_t n;
+    do
+      n = ::read (fd, buffer.data(), buffer.size());
+    while (n < 0 && errno == EINTR);
+    pos = 0;
+    end = n > 0 ? n : 0;
+    return n > 0;
+  }
+
+public:
+  explicit request_reader (int fd)
+    : fd (fd)
+  {}
+
+  // Returns false at the end of the input, or on a line too long to be a
+  // header
+  bool line (std::string & s)
+  {
+    s.clear();
+    while (true)
+    {
+      char const * start = buffer.data() + pos;
+      char const * newline = static_cast<char const *> (std::memchr (start, '\n', end - pos));
+      if (newline != nullptr)
+      {
+        s.append (start, newline);
+        pos += newline - start + 1;
+        return true;
+      }
+      s.append (start, end - pos);
+      pos = end;
+      if (s.size() > max_line || fill() == false)
+        return false;
+    }
+  }
+
+  bool bytes (std::size_t n, std::string & s)
+  {
+    s.clear();
+    while (s.size() < n)
+    {
+      if (pos == end && fill() == false)
+        return false;
+      std::size_t k = std::min (n - s.size(), end - pos);
+      s.append (buffer.data() + pos, k);
+      pos += k;
+    }
+    return true;
+  }
+};
+
+// Standard input and output, or one client of the socket.  Each answer is
+// written whole under a lock, so the threads' answers never interleave.
+class connection
+{
+  int in, out;
+  bool owned;
+  std::mutex mutex;
+
+public:
+  connection (int in, int out, bool owned)
+    : in (in), out (out), owned (owned)
+  {}
+
+  connection (connection const &) = delete;
+  connection & operator = (connection const &) = delete;
+
+  ~connection ()
+  {
+    if (owned)
+      ::close (in);
+  }
+
+  int input () const
+  { return in; }
+
+  // A client which has gone away is not an error; its answers are dropped
+  void answer (std::string const & id, bool ok, double micros, std::string const & body)
+  {
+    std::string text = id + (ok ? " ok " : " error ") + std::to_string ((long long) micros) + ' '
+      + std::to_string (body.size()) + '\n' + body;
+    std::lock_guard<std::mutex> lock (mutex);
+    for (std::size_t done = 0; done < text.size(); )
+    {
+      ssize_t n = ::write (out, text.data() + done, text.size() - done);
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0)
+        return;
+      done += n;
+    }
+  }
+};
+
+struct request
+{
+  std::shared_ptr<connection> from;
+  std::string id, kind, text;
+  clock_type::time_point arrived;
+};
+
+// Requests waiting for a worker
+class request_queue
+{
+  std::mutex mutex;
+  std::condition_variable ready;
+  std::deque<request> requests;
+  bool closed = false;
+
+public:
+  void push (request r)
+  {
+    {
+      std::lock_guard<std::mutex> lock (mutex);
+      requests.push_back (std::move (r));
+    }
+    ready.notify_one();
+  }
+
+  // Waits for a request; returns false once the queue is closed and empty
+  bool pop (request & r)
+  {
+    std::unique_lock<std::mutex> lock (mutex);
+    ready.wait (lock, [&] { return closed || requests.empty() == false; });
+    if (requests.empty())
+      return false;
+    r = std::move (requests.front());
+    requests.pop_front();
+    return true;
+  }
+
+  void close ()
+  {
+    {
+      std::lock_guard<std::mutex> lock (mutex);
+      closed = true;
+    }
+    ready.notify_all();
+  }
+};
+
+/////////////
+// solvers //
+/////////////
+
+struct key_hasher
+{
+  std::size_t operator () (ad::move::key k) const
+  { return ad::move::key_hash (k); }
+};
+
+// A puzzle given up on, having searched as far as the server allows
+struct search_limit : std::runtime_error
+{
+  using std::runtime_error::runtime_error;
+};
+
+// What a search from one Move state found
+struct move_answer
+{
+  bool found = false;
+  bool gave_up = false;
+  std::string moves;
+};
+
+// Everything for a Move board that depends only on the board and the
+// colours of its dots, and the answers found on it so far.  Every state
+// along a solution is answered by the rest of the solution, so a client
+// asking for a hint after each move finds the answer waiting.  A state
+// given up on is remembered as such, so asking again costs nothing.
+struct move_board
+{
+  static constexpr std::size_t max_answers = 1 << 16;
+
+  ad::move::board b;
+  ad::move::codec c;
+  ad::move::slide_table t;
+  ad::move::goal_distance h;
+
+  std::mutex mutex;
+  std::unordered_map<ad::move::key, move_answer, key_hasher> answers;
+
+  move_board (ad::move::board const & board, ad::move::gamestate const & gs)
+    : b (board), c (b, gs), t (b, c), h (b, c, t)
+  {}
+
+  // Whether start can be solved, and the moves of a shortest solution,
+  // expanding at most node_limit states, or any number with 0
+  move_answer solve (ad::move::key start, std::size_t node_limit)
+  {
+    {
+      std::lock_guard<std::mutex> lock (mutex);
+      auto i = answers.find (start);
+      if (i != answers.end())
+        return i -> second;
+    }
+
+    ad::move::search_result r = ad::move::solve_astar (start, c, t, h, node_limit);
+
+    std::lock_guard<std::mutex> lock (mutex);
+    if (answers.size() + r.moves.size() + 1 > max_answers)
+      answers.clear();
+    answers[start] = {r.found, r.gave_up, r.moves};
+    ad::move::key k = start;
+    for (std::size_t i=0; i < r.moves.size(); ++i)
+    {
+      k = ad::move::slide (k, c, t, std::strchr (ad::move::directions, r.moves[i]) - ad::move::directions);
+      answers[k] = {true, false, r.moves.substr (i + 1)};
+    }
+    return {r.found, r.gave_up, r.moves};
+  }
+};
+
+// The placements of the pieces on a Hexus board, and its answer once found.
+// The board is searched once: other requests for it wait for that search,
+// each holding its worker, rather than repeat it, so the node limit bounds
+// their wait as well.  A search given up on is remembered as such.
+struct hexus_board
+{
+  ad::hexus::placement_table coverage;
+  ad::hexus::search_options options;
+
+  std::once_flag solved;
+  bool gave_up = false;
+  std::string answer;
+};
+
+// The solvers, and what they keep between requests
+class engines
+{
+  ad::line_cache lines;
+  ad::board_cache<move_board> move_boards;
+  ad::board_cache<hexus_board> hexus_boards;
+
+  std::map<char, ad::hexus::piece> pieces;
+  std::vector<char> colour_index;
+  ad::hexus::search_options hexus_options;
+  std::size_t move_limit;
+
+  bool solve_nonogram (ad::scanner & in, std::ostream & os)
+  {
+    ad::nonogram ng;
+    if (! (in >> ng))
+      return false;
+    ng.use_cache (&lines);
+    switch (ng.solve())
+    {
+    case ad::nonogram::solved:
+      os << ng;
+      break;
+    case ad::nonogram::multiple:
+      os << "more than one solution was found; one of them is:\n" << ng;
+      break;
+    case ad::nonogram::none:
+      os << "no solution.\n";
+      break;
+    }
+    return true;
+  }
+
+  bool solve_move (ad::scanner & in, std::ostream & os)
+  {
+    using ad::move::operator >>;   // a gamestate is a std::map, out of reach of lookup by argument
+
+    ad::move::board b;
+    ad::move::gamestate gs;
+    if (! (in >> b >> gs))
+      return false;
+    std::shared_ptr<move_board> entry = move_boards.find (ad::move::signature (b, gs), [&]
+    {
+      return std::make_shared<move_board> (b, gs);
+    });
+    if (entry -> c.fits() == false)
+    {
+      os << "too many dots to pack into a " << sizeof (ad::move::key) * 8 << "-bit state.\n";
+      return true;
+    }
+
+    move_answer a = entry -> solve (entry -> c.encode (gs), move_limit);
+    if (a.gave_up)
+      throw search_limit ("gave up after " + std::to_string (move_limit) + " search nodes.\n");
+    if (a.found == false)
+      os << "no solution.\n";
+    else
+      os << "a solution was found:\t" << a.moves << '\n';
+    return true;
+  }
+
+  bool solve_hexus (ad::scanner & in, std::ostream & os)
+  {
+    ad::hexus::board b;
+    if (! (in >> b))
+      return false;
+    std::shared_ptr<hexus_board> entry = hexus_boards.find (ad::hexus::signature (b, pieces), [&]
+    {
+      auto e = std::make_shared<hexus_board>();
+      e -> coverage.build (ad::hexus::place_pieces (b, pieces));
+      e -> options = hexus_options;
+      e -> options.neighbours = ad::hexus::neighbours (b);
+      return e;
+    });
+
+    std::call_once (entry -> solved, [&]
+    {
+      std::vector<int> chosen;
+      ad::hexus::search_stats stats;
+      bool solved = ad::hexus::solve (entry -> coverage, b.cells.size(), chosen, entry -> options, stats);
+      if (solved == false && ad::hexus::gave_up (entry -> options, stats))
+      {
+        entry -> gave_up = true;
+        entry -> answer = "gave up after " + std::to_string (entry -> options.node_limit) + " search nodes.\n";
+        return;
+      }
+
+      std::vector<char> colour_vector (b.cells.size(), '\0');
+      for (std::size_t pc = 0; pc != chosen.size(); ++pc)
+        for (int i : entry -> coverage[pc][chosen[pc]])
+          colour_vector[i] = colour_index[pc];
+
+      std::ostringstream answer;
+      answer << solved << '\n';
+      ad::hexus::print_board (answer, b, colour_vector);
+      entry -> answer = answer.str();
+    });
+    if (entry -> gave_up)
+      throw search_limit (entry -> answer);
+    os << entry -> answer;
+    return true;
+  }
+
+  bool solve_strata (ad::scanner & in, std::ostream & os)
+  {
+    ad::strata::puzzle p;
+    if (! (in >> p))
+      return false;
+    std::vector<ad::strata::step> solution;
+    if (ad::strata::solve (p, solution) == false)
+    {
+      os << "no solution.\n";
+      return true;
+    }
+    for (ad::strata::step const & s : solution)
+      os << s << '\n';
+    return true;
+  }
+
+public:
+  engines (std::size_t line_capacity, std::size_t board_capacity, std::map<char, ad::hexus::piece> const & pieces,
+           std::size_t table_bytes, std::uint64_t node_limit, std::size_t move_limit)
+    : lines (line_capacity), move_boards (board_capacity), hexus_boards (board_capacity), pieces (pieces),
+      move_limit (move_limit)
+  {
+    for (auto const & p : pieces)
+      colour_index.push_back (p.first);
+    hexus_options.table_bytes = table_bytes;
+    hexus_options.node_limit = node_limit;
+  }
+
+  static bool knows (std::string const & kind)
+  { return kind == "nonogram" || kind == "move" || kind == "hexus" || kind == "strata"; }
+
+  // Writes the answer to os and returns true, or returns false if text is
+  // not a puzzle of that kind.  Throws search_limit for a puzzle given up on.
+  bool solve (std::string const & kind, std::string const & text, std::ostream & os)
+  {
+    ad::scanner in;
+    in.assign (text);
+    if (kind == "nonogram")
+      return solve_nonogram (in, os);
+    if (kind == "move")
+      return solve_move (in, os);
+    if (kind == "hexus")
+      return solve_hexus (in, os);
+    return solve_strata (in, os);
+  }
+
+  std::string report ()
+  {
+    std::ostringstream os;
+    os << "line cache: " << lines.hits() << " hits, " << lines.misses() << " misses, "
+       << lines.evictions() << " evictions\n"
+       << "move boards: " << move_boards.hits() << " hits, " << move_boards.misses() << " misses\n"
+       << "hexus boards: " << hexus_boards.hits() << " hits, " << hexus_boards.misses() << " misses\n";
+    return os.str();
+  }
+};
+
+////////////
+// server //
+////////////
+
+class server
+{
+  static constexpr std::size_t max_request = std::size_t (64) << 20;
+
+  engines & solvers;
+  request_queue queue;
+  ad::latency_log latencies;
+  std::vector<std::thread> workers;
+
+  void work ()
+  {
+    for (request r; queue.pop (r); )
+    {
+      std::ostringstream os;
+      bool ok;
+      try
+      {
+        ok = solvers.solve (r.kind, r.text, os);
+        if (ok == false)
+          os << "cannot read the " << r.kind << " puzzle.\n";
+      }
+      catch (std::bad_alloc const &)
+      {
+        ok = false;
+        os.str ("");
+        os << "out of memory.\n";
+      }
+      catch (search_limit const & e)
+      {
+        ok = false;
+        os.str ("");
+        os << e.what();
+      }
+      double micros = std::chrono::duration<double, std::micro> (clock_type::now() - r.arrived).count();
+      r.from -> answer (r.id, ok, micros, os.str());
+      latencies.add (r.kind, micros);
+      r = request();
+    }
+  }
+
+public:
+  server (engines & solvers, unsigned threads)
+    : solvers (solvers)
+  {
+    for (unsigned t=0; t < threads; ++t)
+      workers.emplace_back ([this] { work(); });
+  }
+
+  server (server const &) = delete;
+  server & operator = (server const &) = delete;
+
+  ~server ()
+  { finish(); }
+
+  // Answers what is queued, then stops the workers
+  void finish ()
+  {
+    queue.close();
+    for (std::thread & t : workers)
+      t.join();
+    workers.clear();
+  }
+
+  std::string report ()
+  { return latencies.report() + solvers.report(); }
+
+  // Queues the requests of one connection until it closes, or sends a
+  // header which cannot be read
+  void serve (std::shared_ptr<connection> const & from)
+  {
+    request_reader in (from -> input());
+    std::string header;
+    while (in.line (header))
+    {
+      if (header.empty())
+        continue;
+
+      request r;
+      std::size_t bytes = 0;
+      std::istringstream fields (header);
+      if (! (fields >> r.id >> r.kind >> bytes) || bytes > max_request)
+      {
+        from -> answer (r.id.empty() ? "-" : r.id, false, 0, "bad request header.\n");
+        return;
+      }
+      if (in.bytes (bytes, r.text) == false)
+        return;
+      r.arrived = clock_type::now();
+
+      if (r.kind == "stats")
+        from -> answer (r.id, true, 0, report());
+      else if (engines::knows (r.kind) == false)
+        from -> answer (r.id, false, 0, "unknown puzzle kind " + r.kind + ".\n");
+      else
+      {
+        r.from = from;
+        queue.push (std::move (r));
+      }
+    }
+  }
+};
+
+int listen_on (std::string const & path)
+{
+  sockaddr_un address {};
+  address.sun_family = AF_UNIX;
+  if (path.size() >= sizeof (address.sun_path))
+    return -1;
+  std::strcpy (address.sun_path, path.c_str());
+
+  int fd = ::socket (AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0)
+    return -1;
+  ::unlink (path.c_str());
+  if (::bind (fd, reinterpret_cast<sockaddr *> (&address), sizeof (address)) != 0 || ::listen (fd, 64) != 0)
+  {
+    ::close (fd);
+    return -1;
+  }
+  return fd;
+}
+
+int main (int argc, char ** argv)
+{
+  // -s PATH listens on a Unix domain socket at PATH instead of reading stdin
+  // -j N solves N requests at once, one per processor by default
+  // -c N caches up to N nonogram line solutions, a million by default
+  // -B N keeps what was built for up to N Move and N Hexus boards, 256 by
+  //    default
+  // -p FILE reads the Hexus pieces from a file instead of using the boxed set
+  // -x MB remembers Hexus positions with no tiling in up to MB megabytes per
+  //    search, 64 by default
+  // -l N gives up on a Hexus board after N search nodes, ten million by
+  //    default; 0 never gives up
+  // -M N gives up on a Move state after expanding N states, a million by
+  //    default; 0 never gives up
+  std::string socket_path;
+  unsigned threads = std::max (1u, std::thread::hardware_concurrency());
+  std::size_t line_capacity = 1000000;
+  std::size_t board_capacity = 256;
+  std::string pieces_path;
+  std::size_t table_bytes = 64 << 20;
+  std::uint64_t node_limit = 10000000;
+  std::size_t move_limit = 1000000;
+  for (int a=1; a < argc; ++a)
+    if (std::string (argv[a]) == "-s" && a+1 < argc)
+      socket_path = argv[++a];
+    else if (std::string (argv[a]) == "-j" && a+1 < argc)
+      threads = std::max (1, std::atoi (argv[++a]));
+    else if (std::string (argv[a]) == "-c" && a+1 < argc)
+      line_capacity = std::atol (argv[++a]);
+    else if (std::string (argv[a]) == "-B" && a+1 < argc)
+      board_capacity = std::max (1l, std::atol (argv[++a]));
+    else if (std::string (argv[a]) == "-p" && a+1 < argc)
+      pieces_path = argv[++a];
+    else if (std::string (argv[a]) == "-x" && a+1 < argc)
+      table_bytes = std::atof (argv[++a]) * (1 << 20);
+    else if (std::string (argv[a]) == "-l" && a+1 < argc)
+      node_limit = std::strtoull (argv[++a], nullptr, 10);
+    else if (std::string (argv[a]) == "-M" && a+1 < argc)
+      move_limit = std::strtoull (argv[++a], nullptr, 10);
+
+  std::map<char, ad::hexus::piece> pieces;
+  if (pieces_path.empty())
+    pieces = ad::hexus::standard_pieces();
+  else
+  {
+    std::ifstream file (pieces_path);
+    if (ad::hexus::read_pieces (file, pieces).fail())
+    {
+      std::cerr << "cannot read pieces from " << pieces_path << ".\n";
+      return 1;
+    }
+  }
+
+  // A client closing its socket early must not end the server
+  std::signal (SIGPIPE, SIG_IGN);
+
+  engines solvers (line_capacity, board_capacity, pieces, table_bytes, node_limit, move_limit);
+  server s (solvers, threads);
+
+  // On standard input, the latencies are written to stderr at the end
+  if (socket_path.empty())
+  {
+    s.serve (std::make_shared<connection> (0, 1, false));
+    s.finish();
+    std::cerr << s.report();
+    return 0;
+  }
+
+  int listener = listen_on (socket_path);
+  if (listener < 0)
+  {
+    std::cerr << "cannot listen on " << socket_path << ".\n";
+    return 1;
+  }
+  while (true)
+  {
+    int fd = ::accept (listener, nullptr, nullptr);
+    if (fd < 0)
+    {
+      if (errno == EINTR || errno == ECONNABORTED)
+        continue;
+      std::cerr << "cannot accept connections on " << socket_path << ".\n";
+      return 1;
+    }
+    std::thread ([&s, fd] { s.serve (std::make_shared<connection> (fd, fd, true)); }).detach();
+  }
+}
@@ -0,0 +1,427 @@
+#ifndef AD_HEXUS_BITMASK_SEARCH_HXX
+#define AD_HEXUS_BITMASK_SEARCH_HXX
+
+#include <algorithm>
+#include <bitset>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "../common/metrics.hxx"
+#include "transposition_table.hxx"
+
+namespace ad::hexus
+{
+  // The work done by a search.  Nodes are always counted, the rest only when
+  // built with AD_METRICS.  Threads searching from different nodes each keep
+  // their own, and add them up at the end.
+  struct search_stats
+  {
+    std::uint64_t nodes = 0;
+    std::uint64_t tilings = 0;
+    std::uint64_t table_hits = 0;          // positions found to have failed before
+    std::uint64_t table_stores = 0;
+    std::uint64_t table_evictions = 0;
+    std::uint64_t table_capacity = 0;      // the most positions it holds
+    ad::counter placements_tried;   // tested against the board
+    ad::counter backtracks;         // nodes left without placing anything
+    ad::counter pruned;             // of those, the ones with a dead region
+    ad::histogram depth;            // nodes by the number of pieces placed
+
+    search_stats & operator += (search_stats const & s)
+    {
+      nodes += s.nodes;
+      tilings += s.tilings;
+      table_hits += s.table_hits;
+      table_stores += s.table_stores;
+      table_evictions += s.table_evictions;
+      table_capacity = std::max(table_capacity, s.table_capacity);
+      placements_tried += s.placements_tried.value();
+      backtracks += s.backtracks.value();
+      pruned += s.pruned.value();
+      depth += s.depth;
+      return *this;
+    }
+  };
+
+  // A set of board cells in Words machine words.  The operations are loops
+  // of fixed length, which the compiler unrolls, and vectorises when wider
+  // instructions are enabled (-mavx2 for four words).
+  template <int Words>
+  struct bitmask
+  {
+    std::uint64_t w[Words] = {};
+
+    void set (int i)
+    { w[i / 64] |= std::uint64_t(1) << (i % 64); }
+
+    bool test (int i) const
+    { return (w[i / 64] >> (i % 64)) & 1; }
+
+    bool overlaps (bitmask const & m) const
+    {
+      std::uint64_t any = 0;
+      for (int i=0; i != Words; ++i)
+	any |= w[i] & m.w[i];
+      return any != 0;
+    }
+
+    bitmask & operator |= (bitmask const & m)
+    {
+      for (int i=0; i != Words; ++i)
+	w[i] |= m.w[i];
+      return *this;
+    }
+
+    bitmask & operator &= (bitmask const & m)
+    {
+      for (int i=0; i != Words; ++i)
+	w[i] &= m.w[i];
+      return *this;
+    }
+
+    bitmask operator ~ () const
+    {
+      bitmask m;
+      for (int i=0; i != Words; ++i)
+	m.w[i] = ~w[i];
+      return m;
+    }
+
+    bool operator == (bitmask const & m) const
+    {
+      std::uint64_t diff = 0;
+      for (int i=0; i != Words; ++i)
+	diff |= w[i] ^ m.w[i];
+      return diff == 0;
+    }
+
+    bool none () const
+    {
+      std::uint64_t any = 0;
+      for (int i=0; i != Words; ++i)
+	any |= w[i];
+      return any == 0;
+    }
+
+    int count () const
+    {
+      int n = 0;
+      for (int i=0; i != Words; ++i)
+	n += __builtin_popcountll(w[i]);
+      return n;
+    }
+
+    // Calls f(i) for each set bit i, lowest first
+    template <typename F>
+    void for_each (F f) const
+    {
+      for (int i=0; i != Words; ++i)
+	for (std::uint64_t bits = w[i]; bits != 0; bits &= bits - 1)
+	  f(i * 64 + __builtin_ctzll(bits));
+    }
+
+    bitmask & operator ^= (bitmask const & m)
+    {
+      for (int i=0; i != Words; ++i)
+	w[i] ^= m.w[i];
+      return *this;
+    }
+
+    // The lowest clear bit, or Words * 64 if every bit is set
+    int first_clear () const
+    {
+      for (int i=0; i != Words; ++i)
+	if (~w[i] != 0)
+	  return i * 64 + __builtin_ctzll(~w[i]);
+      return Words * 64;
+    }
+  };
+
+  // Tiles a board of up to Words * 64 cells with up to 63 pieces, each used
+  // exactly once.  The search always fills the lowest empty cell.  Every cell
+  // before it is covered, so only placements whose lowest cell is that cell
+  // can go there; the placements are stored in one flat array, grouped by
+  // their lowest cell, and each is tried with a single overlap test.
+  template <int Words>
+  class bitmask_search
+  {
+  public:
+    using mask = bitmask<Words>;
+
+  private:
+    struct entry
+    {
+      mask cells;
+      int piece;
+      int index;    // within the piece's placements
+      std::uint64_t hash;
+    };
+
+    int n_cells;
+    int n_pieces;
+    std::vector<entry> entries;
+    std::vector<int> first_entry;   // cell -> its entries, up to the next cell's
+    mask outside;                   // the bits past the last cell
+
+    search_stats n_stats;
+    std::uint64_t node_limit = 0;   // 0 for none
+
+    bool prune = false;
+    std::vector<mask> neighbours;   // cell -> the cells next to it
+    std::vector<int> piece_size;
+
+    // Positions without a tiling, found by the xor of a random key for
+    // each cell covered and each piece used; each entry holds the keys of
+    // its cells and piece
+    std::unique_ptr<transposition_table<mask>> failures;
+
+    // Whether the empty cells fall into regions that the unused pieces cannot
+    // fill: one smaller than the smallest of them, or one whose size is not
+    // the total size of some of them.
+    bool dead (mask const & occupied, std::uint64_t used) const
+    {
+      int smallest = max_cells + 1;
+      std::bitset<max_cells + 1> sums;
+      sums[0] = true;
+      for (int p=0; p != n_pieces; ++p)
+	if (((used >> p) & 1) == 0)
+	  {
+	    smallest = std::min(smallest, piece_size[p]);
+	    sums |= sums << piece_size[p];
+	  }
+
+      // Flood fill each region in turn, a ring of cells at a time
+      mask unvisited = ~occupied;
+      for (int cell = occupied.first_clear(); cell < n_cells; cell = (~unvisited).first_clear())
+	{
+	  mask ring;
+	  ring.set(cell);
+	  unvisited ^= ring;
+	  int size = 1;
+	  while (ring.none() == false)
+	    {
+	      mask next;
+	      ring.for_each([&] (int c) { next |= neighbours[c]; });
+	      next &= unvisited;
+	      unvisited ^= next;
+	      size += next.count();
+	      ring = next;
+	    }
+	  if (size < smallest || sums[size] == false)
+	    return true;
+	}
+      return false;
+    }
+
+    template <typename F>
+    bool search (mask & occupied, std::uint64_t used, std::uint64_t hash, std::vector<int> & chosen,
+		 F & on_solution, search_stats & stats) const
+    {
+      ++stats.nodes;
+      if (node_limit != 0 && stats.nodes > node_limit)
+	return false;
+      stats.depth.add(__builtin_popcountll(used));
+      int cell = occupied.first_clear();
+      if (cell >= n_cells)
+	{
+	  if (used + 1 != std::uint64_t(1) << n_pieces)
+	    return true;
+	  ++stats.tilings;
+	  return on_solution(chosen);
+	}
+      if (failures && failures -> contains(hash, occupied, used))
+	{
+	  ++stats.table_hits;
+	  return true;
+	}
+      if (prune && dead(occupied, used))
+	{
+	  ++stats.pruned;
+	  ++stats.backtracks;
+	  if (failures)
+	    failures -> insert(hash, occupied, used);
+	  return true;
+	}
+
+      std::uint64_t tilings = stats.tilings;
+
+      bool placed = false;
+      for (int e = first_entry[cell]; e != first_entry[cell + 1]; ++e)
+	{
+	  entry const & p = entries[e];
+	  if ((used >> p.piece) & 1)
+	    continue;
+	  ++stats.placements_tried;
+	  if (p.cells.overlaps(occupied))
+	    continue;
+
+	  placed = true;
+	  occupied |= p.cells;
+	  chosen[p.piece] = p.index;
+	  bool go_on = search(occupied, used | std::uint64_t(1) << p.piece, hash ^ p.hash, chosen,
+			      on_solution, stats);
+	  occupied ^= p.cells;
+	  if (go_on == false)
+	    return false;
+	}
+      if (placed == false)
+	++stats.backtracks;
+      if (failures && stats.tilings == tilings)
+	failures -> insert(hash, occupied, used);
+      return true;
+    }
+
+  public:
+    static constexpr int max_cells = Words * 64;
+    static constexpr int max_pieces = 63;
+
+    // placements[p][i] lists the cells covered by the i-th way piece p fits.
+    template <typename Placements>
+    bitmask_search (Placements const & placements, int n_cells)
+      : n_cells (n_cells), n_pieces (placements.size()), first_entry (n_cells + 1, 0)
+    {
+      for (int i = n_cells; i != max_cells; ++i)
+	outside.set(i);
+
+      // splitmix64, for the keys of the cells and pieces
+      std::uint64_t seed = 0;
+      auto random = [&seed] ()
+	{
+	  std::uint64_t z = (seed += 0x9e3779b97f4a7c15);
+	  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+	  z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+	  return z ^ (z >> 31);
+	};
+      std::vector<std::uint64_t> cell_key (n_cells), piece_key (n_pieces);
+      for (std::uint64_t & k : cell_key)
+	k = random();
+      for (std::uint64_t & k : piece_key)
+	k = random();
+
+      std::vector<std::vector<entry>> by_cell (n_cells);
+      for (int p=0; p != n_pieces; ++p)
+	for (int i=0; i != int(placements[p].size()); ++i)
+	  {
+	    entry e {mask(), p, i, piece_key[p]};
+	    int lowest = n_cells;
+	    for (int c : placements[p][i])
+	      {
+		e.cells.set(c);
+		e.hash ^= cell_key[c];
+		lowest = std::min(lowest, c);
+	      }
+	    if (lowest != n_cells)
+	      by_cell[lowest].push_back(e);
+	  }
+
+      for (int c=0; c != n_cells; ++c)
+	{
+	  entries.insert(entries.end(), by_cell[c].begin(), by_cell[c].end());
+	  first_entry[c + 1] = entries.size();
+	}
+
+      for (int p=0; p != n_pieces; ++p)
+	piece_size.push_back(placements[p].empty() ? 0 : placements[p].front().size());
+    }
+
+    // Prunes every node whose empty cells cannot be tiled by the pieces
+    // left, judging by the sizes of the regions they form.  adjacent[c]
+    // lists the cells next to cell c.
+    void prune_dead_regions (std::vector<std::vector<int>> const & adjacent)
+    {
+      prune = true;
+      neighbours.assign(n_cells, mask());
+      for (int c=0; c != n_cells; ++c)
+	for (int d : adjacent[c])
+	  neighbours[c].set(d);
+    }
+
+    // Skips positions already found to have no tiling, remembering as many
+    // as fit in bytes.  Threads searching at once share them.
+    void remember_failures (std::size_t bytes)
+    { failures = std::make_unique<transposition_table<mask>>(bytes); }
+
+    // Gives up once more than nodes search nodes have been visited, as
+    // counted in the stats of each search; 0 lets it run to the end.  Giving
+    // up leaves the table of failures sound, as nothing is stored on the way
+    // out.
+    void limit_nodes (std::uint64_t nodes)
+    { node_limit = nodes; }
+
+    // A partial tiling, from which the search can be carried on by itself
+    struct node
+    {
+      mask occupied;
+      std::uint64_t used;
+      std::uint64_t hash;
+      std::vector<int> chosen;
+    };
+
+    node root () const
+    { return node {outside, 0, 0, std::vector<int> (n_pieces, -1)}; }
+
+    // Calls f(child) for each placement that fits the lowest empty cell of n,
+    // unless n is pruned.  Returns false, having done nothing, if the board
+    // is full.
+    template <typename F>
+    bool expand (node const & n, F f) const
+    {
+      int cell = n.occupied.first_clear();
+      if (cell >= n_cells)
+	return false;
+      if (prune && dead(n.occupied, n.used))
+	return true;
+      for (int e = first_entry[cell]; e != first_entry[cell + 1]; ++e)
+	{
+	  entry const & p = entries[e];
+	  if ((n.used >> p.piece) & 1 || p.cells.overlaps(n.occupied))
+	    continue;
+	  node child (n);
+	  child.occupied |= p.cells;
+	  child.used |= std::uint64_t(1) << p.piece;
+	  child.hash ^= p.hash;
+	  child.chosen[p.piece] = p.index;
+	  f(child);
+	}
+      return true;
+    }
+
+    // Carries the search on from n, calling on_solution(chosen) for each
+    // tiling until it returns false.  Adds the work done to stats, so any
+    // number of threads can search from different nodes at once.
+    template <typename F>
+    bool solve_from (node n, F on_solution, search_stats & stats) const
+    { return search(n.occupied, n.used, n.hash, n.chosen, on_solution, stats); }
+
+    // Calls on_solution(chosen) for each tiling, with the placement index
+    // chosen for each piece, until it returns false.
+    template <typename F>
+    void solve (F on_solution)
+    { solve_from(root(), on_solution, n_stats); }
+
+    // Search nodes visited so far
+    std::uint64_t nodes () const
+    { return n_stats.nodes; }
+
+    // The work done by solve(), and the table's stores, evictions and size
+    search_stats stats () const
+    {
+      search_stats s (n_stats);
+      add_table_counts(s);
+      return s;
+    }
+
+    void add_table_counts (search_stats & s) const
+    {
+      if (failures)
+	{
+	  s.table_stores = failures -> stores();
+	  s.table_evictions = failures -> evictions();
+	  s.table_capacity = failures -> capacity();
+	}
+    }
+  };
+}
+
+#endif
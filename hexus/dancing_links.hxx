@@ -0,0 +1,253 @@
+#ifndef AD_DANCING_LINKS_HXX
+#define AD_DANCING_LINKS_HXX
+
+#include <cstdint>
+#include <vector>
+
+#include "../common/metrics.hxx"
+
+namespace ad
+{
+  // Knuth's Algorithm X on dancing links.  Each row is a set of columns,
+  // and a solution is a set of rows which covers every column exactly once.
+  // The nodes live in flat arrays, linked by index; node 0 is the root, and
+  // nodes 1..n_columns are the column headers.
+  class dancing_links
+  {
+    std::vector<int> left, right, up, down;
+    std::vector<int> column;      // node -> column header
+    std::vector<int> row;         // node -> row id
+    std::vector<int> size;        // column header -> number of rows in it
+    std::vector<int> row_start;   // row id -> its first node
+    int n_rows = 0;
+    std::uint64_t n_nodes = 0;
+    std::uint64_t node_limit = 0;   // 0 for none
+    ad::counter n_rows_tried;       // only counted when built with AD_METRICS
+    ad::counter n_dead_ends;
+    ad::histogram n_depth;
+
+    void cover (int c)
+    {
+      right[left[c]] = right[c];
+      left[right[c]] = left[c];
+      for (int i = down[c]; i != c; i = down[i])
+	for (int j = right[i]; j != i; j = right[j])
+	  {
+	    down[up[j]] = down[j];
+	    up[down[j]] = up[j];
+	    --size[column[j]];
+	  }
+    }
+
+    void uncover (int c)
+    {
+      for (int i = up[c]; i != c; i = up[i])
+	for (int j = left[i]; j != i; j = left[j])
+	  {
+	    ++size[column[j]];
+	    down[up[j]] = j;
+	    up[down[j]] = j;
+	  }
+      right[left[c]] = c;
+      left[right[c]] = c;
+    }
+
+    // Takes row r out of its columns, and puts it back
+    void hide (int r)
+    {
+      int j = row_start[r];
+      do
+	{
+	  down[up[j]] = down[j];
+	  up[down[j]] = up[j];
+	  --size[column[j]];
+	}
+      while ((j = right[j]) != row_start[r]);
+    }
+
+    void unhide (int r)
+    {
+      int j = row_start[r];
+      do
+	{
+	  j = left[j];
+	  ++size[column[j]];
+	  down[up[j]] = j;
+	  up[down[j]] = j;
+	}
+      while (j != row_start[r]);
+    }
+
+    // Whether every column of row r is still to be covered
+    bool uncovered (int r) const
+    {
+      int j = row_start[r];
+      do
+	if (right[left[column[j]]] != column[j])
+	  return false;
+      while ((j = right[j]) != row_start[r]);
+      return true;
+    }
+
+    // The column with the fewest rows left, or 0 if every column is covered
+    int choose () const
+    {
+      int best = 0;
+      for (int c = right[0]; c != 0; c = right[c])
+	if (best == 0 || size[c] < size[best])
+	  best = c;
+      return best;
+    }
+
+    template <typename F>
+    bool search (std::vector<int> & rows, F & on_solution)
+    {
+      ++n_nodes;
+      if (node_limit != 0 && n_nodes > node_limit)
+	return false;
+      n_depth.add(rows.size());
+      int c = choose();
+      if (c == 0)
+	return on_solution(rows);
+      if (size[c] == 0)
+	{
+	  ++n_dead_ends;
+	  return true;
+	}
+
+      cover(c);
+      bool go_on = true;
+      for (int r = down[c]; r != c && go_on; r = down[r])
+	{
+	  ++n_rows_tried;
+	  rows.push_back(row[r]);
+	  for (int j = right[r]; j != r; j = right[j])
+	    cover(column[j]);
+
+	  go_on = search(rows, on_solution);
+
+	  for (int j = left[r]; j != r; j = left[j])
+	    uncover(column[j]);
+	  rows.pop_back();
+	}
+      uncover(c);
+      return go_on;
+    }
+
+  public:
+    explicit dancing_links (int n_columns)
+    {
+      for (int c = 0; c <= n_columns; ++c)
+	{
+	  left.push_back(c == 0 ? n_columns : c - 1);
+	  right.push_back(c == n_columns ? 0 : c + 1);
+	  up.push_back(c);
+	  down.push_back(c);
+	  column.push_back(c);
+	  row.push_back(-1);
+	  size.push_back(0);
+	}
+    }
+
+    // Adds a row covering the given columns, numbered from 0.  Rows are
+    // numbered in the order they are added.
+    int add_row (std::vector<int> const & columns)
+    {
+      int first = -1;
+      for (int col : columns)
+	{
+	  int c = col + 1;
+	  int node = left.size();
+	  column.push_back(c);
+	  row.push_back(n_rows);
+
+	  // Append to the bottom of the column
+	  up.push_back(up[c]);
+	  down.push_back(c);
+	  down[up[c]] = node;
+	  up[c] = node;
+	  ++size[c];
+
+	  // Append to the end of the row
+	  if (first < 0)
+	    {
+	      first = node;
+	      left.push_back(node);
+	      right.push_back(node);
+	    }
+	  else
+	    {
+	      left.push_back(left[first]);
+	      right.push_back(first);
+	      right[left[first]] = node;
+	      left[first] = node;
+	    }
+	}
+      row_start.push_back(first);
+      return n_rows++;
+    }
+
+    // Makes solve() give up once it has visited more than nodes search
+    // nodes; 0 lets it run to the end.
+    void limit_nodes (std::uint64_t nodes)
+    { node_limit = nodes; }
+
+    // Calls on_solution(rows) for each solution, with the ids of the rows
+    // in it, until it returns false.
+    template <typename F>
+    void solve (F on_solution)
+    { solve(std::vector<int>(), std::vector<int>(), on_solution); }
+
+    // The same, for the solutions which include the given rows and none of
+    // the excluded ones; there are none if two given rows share a column.
+    template <typename F>
+    void solve (std::vector<int> const & given, std::vector<int> const & excluded, F on_solution)
+    {
+      for (int r : excluded)
+	hide(r);
+
+      std::vector<int> rows;
+      for (int r : given)
+	{
+	  if (uncovered(r) == false)
+	    break;
+	  int j = row_start[r];
+	  do
+	    cover(column[j]);
+	  while ((j = right[j]) != row_start[r]);
+	  rows.push_back(r);
+	}
+
+      if (rows.size() == given.size())
+	search(rows, on_solution);
+
+      for (auto r = rows.rbegin(); r != rows.rend(); ++r)
+	{
+	  int j = row_start[*r];
+	  do
+	    uncover(column[j = left[j]]);
+	  while (j != row_start[*r]);
+	}
+      for (auto r = excluded.rbegin(); r != excluded.rend(); ++r)
+	unhide(*r);
+    }
+
+    // Search nodes visited so far
+    std::uint64_t nodes () const
+    { return n_nodes; }
+
+    // Rows put into a partial solution so far
+    ad::counter const & rows_tried () const
+    { return n_rows_tried; }
+
+    // Nodes with a column no row could cover
+    ad::counter const & dead_ends () const
+    { return n_dead_ends; }
+
+    // Nodes by the number of rows in the partial solution
+    ad::histogram const & depth () const
+    { return n_depth; }
+  };
+}
+
+#endif
@@ -1,282 +1,185 @@
-#include <algorithm>
+#include "hexus.hxx"
+#include "../common/batch.hxx"
+
+#include <cstdlib>
+#include <fstream>
 #include <iostream>
-#include <set>
 #include <map>
-#include <tuple>
+#include <string>
 #include <vector>
 
-std::string colour (char c)
+using namespace ad::hexus;
+
+void print_placement_counts (std::ostream & os, placement_table const & piece_coverage)
 {
-  switch (c)
+  for (std::size_t pc = 0; pc != piece_coverage.size(); ++pc)
     {
-    case 'w': return "\e[38;5;15m";  // White
-    case 'r': return "\e[38;5;9m";   // Red
-    case 'o': return "\e[38;5;202m"; // Orange
-    case 'y': return "\e[38;5;11m";  // Yellow
-    case 'l': return "\e[38;5;10m";  // Lime
-    case 'g': return "\e[38;5;22m";  // Green
-    case 'c': return "\e[38;5;14m";  // Cyan
-    case 'b': return "\e[38;5;20m";  // Blue
-    case 'p': return "\e[38;5;13m";  // Pink
-    default:  return "\e[90m";       // Default
+      os << "map::size(): " << piece_coverage[pc].size() << '\n';
     }
 }
 
-using cell = std::tuple<int,int,int>;
-
-cell rotate (cell c, int r)
-{
-  if (r % 6 == 0) return c;
-
-  return rotate (cell(-std::get<1>(c),
-		      -std::get<2>(c),
-		      -std::get<0>(c)),
-		 r-1);
-}
-
-cell reflect (cell c, int r)
+// Prints whether the board can be tiled, and the tiling found.  Returns the
+// work done.
+search_stats print_solution (std::ostream & os, board const & b, placement_table const & piece_coverage,
+			     std::vector<char> const & colour_index, search_options const & options)
 {
-  if (r % 2 == 0) return c;
+  std::vector<int> chosen;
+  search_stats stats;
+  bool solved = solve(piece_coverage, b.cells.size(), chosen, options, stats);
+  os << solved << '\n';
 
-  cell c2 (std::get<1>(c),
-	   std::get<0>(c),
-	   std::get<2>(c));
-
-  return c2;
-}
+  std::vector<char> colour_vector (b.cells.size(), '\0');
+  for (uint pc = 0; pc != chosen.size(); ++pc)
+    for (int i : piece_coverage[pc][chosen[pc]])
+      colour_vector[i] = colour_index[pc];
 
-cell operator + (cell c1, cell c2)
-{
-  return cell (std::get<0>(c1) + std::get<0>(c2),
-	       std::get<1>(c1) + std::get<1>(c2),
-	       std::get<2>(c1) + std::get<2>(c2));
+  print_board(os, b, colour_vector);
+  return stats;
 }
 
-struct board
-{
-  std::map<cell, int> cells;
-
-  int rows, columns;
-};
-
-struct piece
+void print_table_counts (std::ostream & os, search_stats const & stats, search_options const & options)
 {
-  std::set<cell> cells;
-  char colour;
-};
-
-std::istream & operator >> (std::istream & is, board & b)
-{
-  is >> b.rows >> b.columns;
-
-  int index = 0;
-
-  for (int r=0; r != b.rows; ++r)
-    for (int c=0; c != b.columns; ++c)
-      {
-	char token;
-	is >> token;
-	if (token == '.')
-	  {
-	    int x = c - (r + r%2) / 2;
-	    int z = r;
-	    int y = -x -z;
-	    b.cells.emplace(cell(x,y,z), index);
-	    ++index;
-	  }
-      }
-
-  return is;
+  if (options.table_bytes != 0 && options.use_dancing_links == false)
+    os << "failed positions: " << stats.table_hits << " hits, " << stats.table_stores << " stores, "
+       << stats.table_evictions << " evictions, room for " << stats.table_capacity << '\n';
 }
 
-std::ostream & operator << (std::ostream & os, board const & b)
+int main (int argc, char ** argv)
 {
-  for (int r=0; r != b.rows; ++r)
-    {
-      if (r % 2 == 0)
-	os << "  ";
-      for (int c=0; c != b.columns; ++c)
-	{
-	  int x = c - (r + r%2) / 2;
-	  int z = r;
-	  int y = -x -z;
-	  cell loc (x,y,z);
-	  if (b.cells.count(loc) == 1)
-	    os << colour(b.cells.at(loc)) << "(X) " << colour('\0');
-	  else
-	    os << "    ";
-	}
-      os << '\n';
-    }
-  return os;
-}
+  // -d searches with dancing links
+  // -n does not prune dead regions from the bitmask search
+  // -a finds every tiling, and prints one of each up to symmetry
+  // -j N finds every tiling on N threads
+  // -p FILE reads the pieces from a file instead of using the boxed set
+  // -t FILE maps the placements from a file, written if needed
+  // -b solves every board in the input, one after another, N at once with -j
+  // -i FILE reads the batch from a file instead of stdin
+  // -m writes the search's metrics to stderr as JSON
+  // -x MB remembers positions with no tiling in up to MB megabytes, 64 by
+  //    default; 0 remembers none
+  search_options options;
+  options.table_bytes = 64 << 20;
+  bool prune = true;
+  bool all = false;
+  int threads = 1;
+  std::string pieces_path, table_path;
+  bool batch = false;
+  std::string input_path;
+  bool metrics = false;
+  for (int i=1; i < argc; ++i)
+    if (std::string(argv[i]) == "-d")
+      options.use_dancing_links = true;
+    else if (std::string(argv[i]) == "-n")
+      prune = false;
+    else if (std::string(argv[i]) == "-a")
+      all = true;
+    else if (std::string(argv[i]) == "-j" && i+1 < argc)
+      threads = std::atoi(argv[++i]);
+    else if (std::string(argv[i]) == "-p" && i+1 < argc)
+      pieces_path = argv[++i];
+    else if (std::string(argv[i]) == "-t" && i+1 < argc)
+      table_path = argv[++i];
+    else if (std::string(argv[i]) == "-b")
+      batch = true;
+    else if (std::string(argv[i]) == "-i" && i+1 < argc)
+      input_path = argv[++i];
+    else if (std::string(argv[i]) == "-m")
+      metrics = true;
+    else if (std::string(argv[i]) == "-x" && i+1 < argc)
+      options.table_bytes = std::atof(argv[++i]) * (1 << 20);
+  if (threads > 1 && batch == false)
+    all = true;
 
-void print_board (std::ostream & os, board const & b, std::vector<char> const & colour_vector)
-{
-  for (int r=0; r != b.rows; ++r)
+  std::map<char, piece> pieces;
+  if (pieces_path.empty())
+    pieces = standard_pieces();
+  else
     {
-      if (r % 2 == 0)
-	os << "  ";
-      for (int c=0; c != b.columns; ++c)
+      std::ifstream file (pieces_path);
+      if (read_pieces(file, pieces).fail())
 	{
-	  int x = c - (r + r%2) / 2;
-	  int z = r;
-	  int y = -x -z;
-	  cell loc (x,y,z);
-	  if (b.cells.count(loc) == 1)
-	    os << colour(colour_vector.at(b.cells.at(loc))) << "(X) " << colour('\0');
-	  else
-	    os << "    ";
+	  std::cerr << "cannot read pieces from " << pieces_path << ".\n";
+	  return 1;
 	}
-      os << '\n';
     }
-}
-
-bool solve (std::vector< std::map<std::vector<bool>, bool> > & piece_coverage, std::vector<bool> & board, int index)
-{
-  // std::cerr << "Trying to solve at index: " << index << '\n';
-  // std::cerr << "board: ";
-  // for (bool b : board)
-  //   std::cerr << b;
-  // std::cerr << '\n';
-
-  if (std::all_of(board.begin(), board.end(), [](bool b){ return b; }))
-    return true;
 
-  // Select the piece at index
-  std::map<std::vector<bool>, bool> & piece = piece_coverage[index];
+  std::vector<char> colour_index;
+  for (auto const & p : pieces)
+    colour_index.push_back(p.first);
 
-  // Loop through each position for this piece
-  for (auto & positioning : piece)
+  if (batch)
     {
-      // If the position fits ...
-      if (std::equal(board.begin(), board.end(),
-		     positioning.first.begin(),
-		     [](bool a, bool b){ return (a && b) == false; }))
+      ad::scanner in;
+      if (input_path.empty() ? in.read_all(0) == false : in.open(input_path) == false)
 	{
-	  // ... then set its bits to true
-	  positioning.second = true;
-	  for (uint i=0; i != positioning.first.size(); ++i)
-	    board[i] = board[i] || positioning.first[i];
-
-	  // Recurse
-	  if (solve(piece_coverage, board, index+1))
-	    return true;
-
-	  // If solve(...) did not return true, then remove the bits
-	  // that were set in the previous loop
-	  positioning.second = false;
-	  for (uint i=0; i != positioning.first.size(); ++i)
-	    board[i] = board[i] != positioning.first[i];
+	  std::cerr << "cannot read " << (input_path.empty() ? "stdin" : input_path) << ".\n";
+	  return 1;
 	}
+      ad::thread_pool pool (threads);
+      bool ok = ad::run_batch<board>(in, pool, std::cout, [&] (board const & b, std::ostream & os)
+	{
+	  placement_table piece_coverage;
+	  piece_coverage.build(place_pieces(b, pieces));
+	  search_options board_options (options);
+	  if (prune)
+	    board_options.neighbours = neighbours(b);
+	  print_placement_counts(os, piece_coverage);
+	  print_solution(os, b, piece_coverage, colour_index, board_options);
+	});
+      return ok ? 0 : 1;
     }
 
-  // If none of the possible positions lead to a solution, then return false.
-  return false;
-}
-
-
-int main ()
-{
   board b;
   std::cin >> b;
   // std::cout << b;
 
-  // std::vector<piece> pieces;
-  std::map<char, piece> pieces;
-
-  // pieces['r'].cells.insert(cell( 0,  0,  0));
-
-  pieces['o'].cells.insert(cell( 0,  0,  0));
-  pieces['o'].cells.insert(cell( 1, -1,  0));
-  pieces['o'].cells.insert(cell( 1, -2,  1));
-  pieces['o'].cells.insert(cell( 0, -2,  2));
-  pieces['o'].cells.insert(cell(-1, -1,  2));
-
-  pieces['y'].cells.insert(cell( 0,  0,  0));
-  pieces['y'].cells.insert(cell( 1, -1,  0));
-  pieces['y'].cells.insert(cell( 2, -2,  0));
-  pieces['y'].cells.insert(cell( 0, -1,  1));
-  pieces['y'].cells.insert(cell( 2, -3,  1));
-
-  pieces['l'].cells.insert(cell( 0,  0,  0));
-  pieces['l'].cells.insert(cell( 1, -1,  0));
-  pieces['l'].cells.insert(cell( 2, -2,  0));
-  pieces['l'].cells.insert(cell( 0, -1,  1));
-
-  pieces['g'].cells.insert(cell( 0,  0,  0));
-  pieces['g'].cells.insert(cell( 1, -1,  0));
-  pieces['g'].cells.insert(cell( 2, -2,  0));
-  pieces['g'].cells.insert(cell( 0, -1,  1));
-  pieces['g'].cells.insert(cell( 0, -2,  2));
-
-  pieces['c'].cells.insert(cell( 0,  0,  0));
-  pieces['c'].cells.insert(cell( 1, -1,  0));
-  pieces['c'].cells.insert(cell( 1, -2,  1));
-  pieces['c'].cells.insert(cell( 0, -2,  2));
-  pieces['c'].cells.insert(cell(-1, -2,  3));
-
-  pieces['b'].cells.insert(cell( 0,  0,  0));
-  pieces['b'].cells.insert(cell( 1, -1,  0));
-  pieces['b'].cells.insert(cell( 2, -2,  0));
-  pieces['b'].cells.insert(cell( 2, -3,  1));
+  placement_table piece_coverage;
+  if (table_path.empty() || piece_coverage.open(table_path, signature(b, pieces)) == false)
+    {
+      piece_coverage.build(place_pieces(b, pieces));
+      if (table_path.empty() == false && piece_coverage.write(table_path, signature(b, pieces)) == false)
+	std::cerr << "cannot write the placement table to " << table_path << ".\n";
+    }
 
-  pieces['p'].cells.insert(cell( 0,  0,  0));
-  pieces['p'].cells.insert(cell( 1, -1,  0));
-  pieces['p'].cells.insert(cell( 1, -2,  1));
-  pieces['p'].cells.insert(cell( 0, -2,  2));
+  if (prune)
+    options.neighbours = neighbours(b);
 
-  std::vector< std::map<std::vector<bool>, bool> > piece_coverage (pieces.size());
-  std::vector<char> colour_index (pieces.size());
+  print_placement_counts(std::cout, piece_coverage);
 
-  int index = 0;
-  // For each piece
-  for (std::pair<char, piece> const & p : pieces)
+  if (all)
     {
-      // For each cell on the board
-      for (std::pair<cell,int> const & translation : b.cells)
-	// For each rotation ...
-	for (int rot=0; rot != 6; ++rot)
-	  // ... and each reflection
-	  for (int ref=0; ref != 2; ++ref)
-	    {
-	      // std::cerr << "rot: " << rot << "\tref: " << ref << '\n';
-	      // Transform the piece
-	      std::set<cell> transformed_piece;
-	      for (cell const & c : p.second.cells)
-		transformed_piece.insert(rotate(reflect(c, ref), rot) + translation.first);
-
-	      // If every cell of the piece can fit in the board ...
-	      if (std::all_of(transformed_piece.begin(), transformed_piece.end(),
-			      [&](cell const & c) { return b.cells.count(c) == 1; }))
-		{
-		  // Then construct a vector<bool> and insert it into the map
-		  std::vector<bool> coverage (b.cells.size(), false);
-		  for (cell const & c : transformed_piece)
-		    coverage[b.cells.at(c)] = true;
-		  piece_coverage[index].emplace(std::move(coverage), false);
-		}
-	    }
+      // Deep enough to give every thread plenty of tasks to steal
+      int const split_depth = 3;
+
+      ad::work_stealing_pool pool (threads);
+      solution_sink sink (symmetries(b));
+      search_stats stats = enumerate(piece_coverage, b.cells.size(), pool, split_depth, sink, options);
+      std::cerr << stats.nodes << " search nodes\n";
+      print_table_counts(std::cerr, stats, options);
+      if (metrics)
+	{
+	  ad::json_writer j (std::cerr);
+	  write_metrics(j, stats);
+	}
 
-      colour_index[index] = p.first;
-      ++index;
+      std::cout << sink.count() << " solutions, " << sink.distinct().size() << " distinct up to symmetry\n";
+      for (tiling const & t : sink.distinct())
+	{
+	  std::vector<char> colour_vector (t.size());
+	  for (std::size_t i=0; i != t.size(); ++i)
+	    colour_vector[i] = colour_index[t[i]];
+	  std::cout << '\n';
+	  print_board(std::cout, b, colour_vector);
+	}
+      return 0;
     }
 
-  for (auto const & pc : piece_coverage)
+  search_stats stats = print_solution(std::cout, b, piece_coverage, colour_index, options);
+  std::cerr << stats.nodes << " search nodes\n";
+  print_table_counts(std::cerr, stats, options);
+  if (metrics)
     {
-      std::cout << "map::size(): " << pc.size() << '\n';
+      ad::json_writer j (std::cerr);
+      write_metrics(j, stats);
     }
-
-  std::vector<bool> bool_board (b.cells.size(), false);
-  std::cout << solve(piece_coverage, bool_board, 0) << '\n';
-
-  std::vector<char> colour_vector (b.cells.size(), '\0');
-  for (uint pc = 0; pc != piece_coverage.size(); ++pc)
-    for (std::pair<std::vector<bool>, bool> const & p : piece_coverage.at(pc))
-      if (p.second)
-	for (uint i=0; i != p.first.size(); ++i)
-	  if (p.first[i])
-	    colour_vector[i] = colour_index[pc];
-
-  print_board(std::cout, b, colour_vector);
 }
@@ -0,0 +1,695 @@
+#ifndef AD_HEXUS_HXX
+#define AD_HEXUS_HXX
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <set>
+#include <sstream>
+#include <mutex>
+#include <tuple>
+#include <vector>
+
+#include "../common/work_stealing_pool.hxx"
+#include "bitmask_search.hxx"
+#include "dancing_links.hxx"
+#include "placement_table.hxx"
+
+namespace ad::hexus
+{
+  std::string colour (char c)
+  {
+    switch (c)
+      {
+      case 'w': return "\e[38;5;15m";  // White
+      case 'r': return "\e[38;5;9m";   // Red
+      case 'o': return "\e[38;5;202m"; // Orange
+      case 'y': return "\e[38;5;11m";  // Yellow
+      case 'l': return "\e[38;5;10m";  // Lime
+      case 'g': return "\e[38;5;22m";  // Green
+      case 'c': return "\e[38;5;14m";  // Cyan
+      case 'b': return "\e[38;5;20m";  // Blue
+      case 'p': return "\e[38;5;13m";  // Pink
+      default:  return "\e[90m";       // Default
+      }
+  }
+
+  using cell = std::tuple<int,int,int>;
+
+  cell rotate (cell c, int r)
+  {
+    if (r % 6 == 0) return c;
+
+    return rotate (cell(-std::get<1>(c),
+			-std::get<2>(c),
+			-std::get<0>(c)),
+		   r-1);
+  }
+
+  cell reflect (cell c, int r)
+  {
+    if (r % 2 == 0) return c;
+
+    cell c2 (std::get<1>(c),
+	     std::get<0>(c),
+	     std::get<2>(c));
+
+    return c2;
+  }
+
+  cell operator + (cell c1, cell c2)
+  {
+    return cell (std::get<0>(c1) + std::get<0>(c2),
+		 std::get<1>(c1) + std::get<1>(c2),
+		 std::get<2>(c1) + std::get<2>(c2));
+  }
+
+  cell operator - (cell c1, cell c2)
+  {
+    return cell (std::get<0>(c1) - std::get<0>(c2),
+		 std::get<1>(c1) - std::get<1>(c2),
+		 std::get<2>(c1) - std::get<2>(c2));
+  }
+
+  struct board
+  {
+    std::map<cell, int> cells;
+
+    int rows, columns;
+  };
+
+  struct piece
+  {
+    std::set<cell> cells;
+    char colour;
+  };
+
+  // Reads from a std::istream or an ad::scanner
+  template <typename Input>
+  Input & operator >> (Input & is, board & b)
+  {
+    is >> b.rows >> b.columns;
+
+    int index = 0;
+
+    for (int r=0; r != b.rows; ++r)
+      for (int c=0; c != b.columns; ++c)
+	{
+	  char token;
+	  is >> token;
+	  if (token == '.')
+	    {
+	      int x = c - (r + r%2) / 2;
+	      int z = r;
+	      int y = -x -z;
+	      b.cells.emplace(cell(x,y,z), index);
+	      ++index;
+	    }
+	}
+
+    return is;
+  }
+
+  std::ostream & operator << (std::ostream & os, board const & b)
+  {
+    for (int r=0; r != b.rows; ++r)
+      {
+	if (r % 2 == 0)
+	  os << "  ";
+	for (int c=0; c != b.columns; ++c)
+	  {
+	    int x = c - (r + r%2) / 2;
+	    int z = r;
+	    int y = -x -z;
+	    cell loc (x,y,z);
+	    if (b.cells.count(loc) == 1)
+	      os << colour(b.cells.at(loc)) << "(X) " << colour('\0');
+	    else
+	      os << "    ";
+	  }
+	os << '\n';
+      }
+    return os;
+  }
+
+  void print_board (std::ostream & os, board const & b, std::vector<char> const & colour_vector)
+  {
+    for (int r=0; r != b.rows; ++r)
+      {
+	if (r % 2 == 0)
+	  os << "  ";
+	for (int c=0; c != b.columns; ++c)
+	  {
+	    int x = c - (r + r%2) / 2;
+	    int z = r;
+	    int y = -x -z;
+	    cell loc (x,y,z);
+	    if (b.cells.count(loc) == 1)
+	      os << colour(colour_vector.at(b.cells.at(loc))) << "(X) " << colour('\0');
+	    else
+	      os << "    ";
+	  }
+	os << '\n';
+      }
+  }
+
+  // Reads pieces drawn on a grid laid out as a board: two integers, rows
+  // and columns, then a character for each cell.  Every cell marked with the
+  // same character, other than '.' or 'x', belongs to the piece of that
+  // colour.
+  std::istream & read_pieces (std::istream & is, std::map<char, piece> & pieces)
+  {
+    int rows, columns;
+    is >> rows >> columns;
+
+    for (int r=0; r != rows; ++r)
+      for (int c=0; c != columns; ++c)
+	{
+	  char token;
+	  is >> token;
+	  if (token != '.' && token != 'x')
+	    {
+	      int x = c - (r + r%2) / 2;
+	      int z = r;
+	      int y = -x -z;
+	      pieces[token].cells.insert(cell(x,y,z));
+	      pieces[token].colour = token;
+	    }
+	}
+
+    return is;
+  }
+
+  // The seven pieces of the boxed game
+  std::map<char, piece> standard_pieces ()
+  {
+    std::istringstream drawing ("4 29\n"
+				"oo..yyy..lll.ggg.cc..bbb..pp.\n"
+				"..o..y.y..l...g....c....b...p\n"
+				"oo............g...c........p.\n"
+				"..................c..........\n");
+    std::map<char, piece> pieces;
+    read_pieces(drawing, pieces);
+    return pieces;
+  }
+
+  // The distinct shapes a piece takes under rotation and reflection, each
+  // as its cells in order, moved so that the first is at the origin.
+  std::vector< std::vector<cell> > orientations (piece const & p)
+  {
+    std::set< std::vector<cell> > shapes;
+    for (int rot=0; rot != 6; ++rot)
+      for (int ref=0; ref != 2; ++ref)
+	{
+	  std::vector<cell> shape;
+	  for (cell const & c : p.cells)
+	    shape.push_back(rotate(reflect(c, ref), rot));
+	  std::sort(shape.begin(), shape.end());
+	  cell origin = shape.front();
+	  for (cell & c : shape)
+	    c = c - origin;
+	  shapes.insert(std::move(shape));
+	}
+    return std::vector< std::vector<cell> > (shapes.begin(), shapes.end());
+  }
+
+  // The board cells a piece covers in one position
+  using placement = std::vector<int>;
+
+  // Every way each piece fits on the board.  Each piece's placements are in
+  // descending order of their cell lists.  Whichever order a search places
+  // the pieces in, solve() reports the tiling that comes first by the first
+  // piece's placement, then the second's, and so on (first_in_piece_order).
+  std::vector< std::vector<placement> > place_pieces (board const & b, std::map<char, piece> const & pieces)
+  {
+    std::vector< std::vector<placement> > piece_coverage;
+
+    for (auto const & p : pieces)
+      {
+	std::vector<placement> placements;
+
+	// Each shape can be placed with its first cell on each board cell;
+	// no two of these cover the same cells.
+	for (std::vector<cell> const & shape : orientations(p.second))
+	  for (auto const & translation : b.cells)
+	    {
+	      placement coverage;
+	      for (cell const & c : shape)
+		{
+		  auto on_board = b.cells.find(c + translation.first);
+		  if (on_board == b.cells.end())
+		    break;
+		  coverage.push_back(on_board -> second);
+		}
+	      if (coverage.size() == shape.size())
+		{
+		  std::sort(coverage.begin(), coverage.end());
+		  placements.push_back(std::move(coverage));
+		}
+	    }
+
+	std::sort(placements.begin(), placements.end(), std::greater<placement>());
+	piece_coverage.push_back(std::move(placements));
+      }
+    return piece_coverage;
+  }
+
+  // Identifies a board and piece set, to tell whether a saved placement table
+  // belongs to them
+  std::uint64_t signature (board const & b, std::map<char, piece> const & pieces)
+  {
+    std::uint64_t h = 0xcbf29ce484222325;
+    auto mix = [&] (std::int64_t v)
+      {
+	h ^= std::uint64_t(v);
+	h *= 0x100000001b3;
+      };
+
+    mix(b.cells.size());
+    for (auto const & c : b.cells)
+      {
+	mix(std::get<0>(c.first));
+	mix(std::get<1>(c.first));
+	mix(c.second);
+      }
+    mix(pieces.size());
+    for (auto const & p : pieces)
+      {
+	mix(p.first);
+	mix(p.second.cells.size());
+	for (cell const & c : p.second.cells)
+	  {
+	    mix(std::get<0>(c));
+	    mix(std::get<1>(c));
+	  }
+      }
+    return h;
+  }
+
+  // The board as an exact cover problem: one column per board cell and one
+  // per piece, and one row per placement, covering its cells and its piece.
+  class exact_cover
+  {
+    ad::dancing_links dlx;
+    std::vector<std::pair<int, int>> rows;   // row -> piece, placement
+    std::vector<std::vector<int>> row_of;    // piece, placement -> row
+    std::uint64_t n_tilings = 0;
+
+  public:
+    exact_cover (placement_table const & piece_coverage, int n_cells, std::uint64_t node_limit)
+      : dlx (n_cells + piece_coverage.size()), row_of (piece_coverage.size())
+    {
+      for (std::size_t pc = 0; pc != piece_coverage.size(); ++pc)
+	for (std::size_t i = 0; i != piece_coverage[pc].size(); ++i)
+	  {
+	    placement_table::cell_range cells = piece_coverage[pc][i];
+	    std::vector<int> columns (cells.begin(), cells.end());
+	    columns.push_back(n_cells + pc);
+	    row_of[pc].push_back(dlx.add_row(columns));
+	    rows.emplace_back(pc, i);
+	  }
+      dlx.limit_nodes(node_limit);
+    }
+
+    // Calls on_tiling(chosen) for each tiling, with the placement index used
+    // for each piece, until it returns false or more than node_limit nodes
+    // have been visited.  Only tilings using the placements in fixed for
+    // the first pieces, and one before below for the piece after them, are
+    // found.
+    template <typename F>
+    void tilings (std::vector<int> const & fixed, int below, F on_tiling)
+    {
+      std::vector<int> given, excluded;
+      for (std::size_t pc = 0; pc != fixed.size(); ++pc)
+	given.push_back(row_of[pc][fixed[pc]]);
+      if (fixed.size() != row_of.size())
+	for (int i = below; i < int(row_of[fixed.size()].size()); ++i)
+	  excluded.push_back(row_of[fixed.size()][i]);
+
+      std::vector<int> chosen (row_of.size());
+      dlx.solve(given, excluded, [&] (std::vector<int> const & solution)
+		{
+		  for (int r : solution)
+		    chosen[rows[r].first] = rows[r].second;
+		  ++n_tilings;
+		  return on_tiling(chosen);
+		});
+    }
+
+    // The work done so far: each row tried is a placement, and each column
+    // no row can cover a backtrack.  Nothing is pruned and there is no table
+    // of failures.
+    search_stats stats () const
+    {
+      search_stats s;
+      s.nodes = dlx.nodes();
+      s.tilings = n_tilings;
+      s.placements_tried += dlx.rows_tried().value();
+      s.backtracks += dlx.dead_ends().value();
+      s.depth += dlx.depth();
+      return s;
+    }
+  };
+
+  // Calls on_tiling(chosen) for each tiling, with the placement index used
+  // for each piece, until it returns false or more than node_limit nodes
+  // have been visited, and returns the work done.
+  template <typename F>
+  search_stats dancing_links_tilings (placement_table const & piece_coverage, int n_cells,
+				       std::uint64_t node_limit, F on_tiling)
+  {
+    exact_cover problem (piece_coverage, n_cells, node_limit);
+    problem.tilings(std::vector<int>(), std::numeric_limits<int>::max(), on_tiling);
+    return problem.stats();
+  }
+
+  // How to search for tilings
+  struct search_options
+  {
+    bool use_dancing_links = false;
+
+    // The cells next to each cell, to prune the bitmask search where the
+    // empty cells split into regions the pieces left cannot fill.  Left
+    // empty, nothing is pruned.
+    std::vector< std::vector<int> > neighbours;
+
+    // The bytes of memory for remembering positions of the bitmask search
+    // which have no tiling, so that reaching one again by placing the same
+    // pieces in another order skips it.  0 remembers none.
+    std::size_t table_bytes = 0;
+
+    // The most search nodes solve() visits before giving up, as if there
+    // were no tiling; 0 for no limit.  It gave up if it returns false with
+    // more nodes counted than this.  Giving up after a tiling is found
+    // returns that one, which may not be the first in piece order.
+    std::uint64_t node_limit = 0;
+  };
+
+  // Whether a search with options which found no tiling stopped at its node
+  // limit
+  bool gave_up (search_options const & options, search_stats const & stats)
+  { return options.node_limit != 0 && stats.nodes > options.node_limit; }
+
+  // The cells next to each cell of the board
+  std::vector< std::vector<int> > neighbours (board const & b)
+  {
+    static cell const directions[] = {cell( 1, -1,  0), cell( 1,  0, -1), cell( 0,  1, -1),
+				       cell(-1,  1,  0), cell(-1,  0,  1), cell( 0, -1,  1)};
+
+    std::vector< std::vector<int> > result (b.cells.size());
+    for (auto const & c : b.cells)
+      for (cell const & d : directions)
+	{
+	  auto next = b.cells.find(c.first + d);
+	  if (next != b.cells.end())
+	    result[c.second].push_back(next -> second);
+	}
+    return result;
+  }
+
+  // Turns the tiling in chosen into the first in the order of trying each
+  // placement of the first piece, and for each the placements of the
+  // second, and so on: the earliest placement of the first piece that some
+  // tiling uses, then the earliest of the second alongside it, and so on.
+  // Each search for a tiling with a piece placed earlier than in chosen
+  // branches on that piece first, having the fewest rows left, so proving
+  // there is none is quick.  Adds the work done to stats, and shares the
+  // node limit with what it holds.
+  void first_in_piece_order (placement_table const & piece_coverage, int n_cells,
+			     search_options const & options, std::vector<int> & chosen, search_stats & stats)
+  {
+    std::uint64_t node_limit = options.node_limit;
+    if (node_limit != 0)
+      node_limit = std::max<std::uint64_t>(node_limit - std::min(node_limit, stats.nodes), 1);
+
+    exact_cover problem (piece_coverage, n_cells, node_limit);
+    std::vector<int> fixed;
+    for (std::size_t pc = 0; pc != chosen.size(); ++pc)
+      {
+	for (bool found = true; found; )
+	  {
+	    found = false;
+	    problem.tilings(fixed, chosen[pc], [&] (std::vector<int> const & tiling)
+			    {
+			      chosen = tiling;
+			      found = true;
+			      return false;
+			    });
+	  }
+	fixed.push_back(chosen[pc]);
+      }
+    stats += problem.stats();
+  }
+
+  bool solve_dancing_links (placement_table const & piece_coverage, int n_cells,
+			    std::vector<int> & chosen, search_options const & options, search_stats & stats)
+  {
+    chosen.clear();
+    stats = dancing_links_tilings(piece_coverage, n_cells, options.node_limit,
+				  [&] (std::vector<int> const & tiling)
+				  {
+				    chosen = tiling;
+				    return false;
+				  });
+    if (chosen.empty())
+      return false;
+    first_in_piece_order(piece_coverage, n_cells, options, chosen, stats);
+    return true;
+  }
+
+  template <int Words>
+  bitmask_search<Words> make_bitmask_search (placement_table const & piece_coverage, int n_cells,
+					     search_options const & options)
+  {
+    bitmask_search<Words> search (piece_coverage, n_cells);
+    if (options.neighbours.empty() == false)
+      search.prune_dead_regions(options.neighbours);
+    if (options.table_bytes != 0)
+      search.remember_failures(options.table_bytes);
+    return search;
+  }
+
+  // Finds a tiling with the bitmask search, which is quickest to find one
+  // or to show there is none, then moves it to the first in piece order.
+  template <int Words>
+  bool solve_bitmask (placement_table const & piece_coverage, int n_cells,
+		      std::vector<int> & chosen, search_options const & options, search_stats & stats)
+  {
+    bitmask_search<Words> search = make_bitmask_search<Words>(piece_coverage, n_cells, options);
+    search.limit_nodes(options.node_limit);
+    chosen.clear();
+    search.solve([&] (std::vector<int> const & tiling)
+		 {
+		   chosen = tiling;
+		   return false;
+		 });
+    stats = search.stats();
+    if (chosen.empty())
+      return false;
+    first_in_piece_order(piece_coverage, n_cells, options, chosen, stats);
+    return true;
+  }
+
+  // Tiles the board with every piece, filling chosen with the placement
+  // index used for each and stats with the work done.  The tiling is the
+  // first in piece order, whichever search finds it.  Boards of up
+  // to 256 cells use a bitmask search sized to fit; larger boards, or more
+  // pieces than fit in a word, fall back to dancing links, as does
+  // options.use_dancing_links.
+  bool solve (placement_table const & piece_coverage, int n_cells,
+	      std::vector<int> & chosen, search_options const & options, search_stats & stats)
+  {
+    if (options.use_dancing_links || int(piece_coverage.size()) > bitmask_search<1>::max_pieces)
+      return solve_dancing_links(piece_coverage, n_cells, chosen, options, stats);
+    if (n_cells <= bitmask_search<1>::max_cells)
+      return solve_bitmask<1>(piece_coverage, n_cells, chosen, options, stats);
+    if (n_cells <= bitmask_search<2>::max_cells)
+      return solve_bitmask<2>(piece_coverage, n_cells, chosen, options, stats);
+    if (n_cells <= bitmask_search<4>::max_cells)
+      return solve_bitmask<4>(piece_coverage, n_cells, chosen, options, stats);
+    return solve_dancing_links(piece_coverage, n_cells, chosen, options, stats);
+  }
+
+  // Dancing links prunes nothing and keeps no table, so it leaves those at 0
+  void write_metrics (ad::json_writer & j, search_stats const & stats)
+  {
+    j.begin("hexus")
+      .field("nodes", stats.nodes)
+      .field("placements_tried", stats.placements_tried)
+      .field("backtracks", stats.backtracks)
+      .field("pruned", stats.pruned)
+      .field("depth", stats.depth)
+      .field("table_hits", stats.table_hits)
+      .field("table_stores", stats.table_stores)
+      .field("table_evictions", stats.table_evictions)
+      .field("table_capacity", stats.table_capacity)
+      .end();
+  }
+
+  /////////////////////////////
+  // enumerating all tilings //
+  /////////////////////////////
+
+  // The rotations and reflections which map the board onto itself, each as
+  // a permutation of the cell indices.  The identity is always the first.
+  std::vector< std::vector<int> > symmetries (board const & b)
+  {
+    std::vector< std::vector<int> > result;
+    if (b.cells.empty())
+      return result;
+
+    for (int rot=0; rot != 6; ++rot)
+      for (int ref=0; ref != 2; ++ref)
+	{
+	  // Line the smallest cell of the image up with the smallest cell
+	  std::set<cell> image;
+	  for (auto const & c : b.cells)
+	    image.insert(rotate(reflect(c.first, ref), rot));
+	  cell shift = b.cells.begin() -> first - *image.begin();
+
+	  std::vector<int> permutation (b.cells.size());
+	  bool maps_onto_itself = true;
+	  for (auto const & c : b.cells)
+	    {
+	      auto to = b.cells.find(rotate(reflect(c.first, ref), rot) + shift);
+	      if (to == b.cells.end())
+		{
+		  maps_onto_itself = false;
+		  break;
+		}
+	      permutation[c.second] = to -> second;
+	    }
+	  if (maps_onto_itself && std::find(result.begin(), result.end(), permutation) == result.end())
+	    result.push_back(std::move(permutation));
+	}
+    return result;
+  }
+
+  // A tiling, as the index of the piece covering each cell
+  using tiling = std::vector<char>;
+
+  // Collects tilings from any number of threads.  It counts them all, and
+  // keeps one of each set of tilings which are the same up to a symmetry of
+  // the board: the least of their images.
+  class solution_sink
+  {
+    std::vector< std::vector<int> > board_symmetries;
+
+    std::mutex mutex;
+    std::uint64_t n_solutions = 0;
+    std::set<tiling> distinct_solutions;
+
+  public:
+    explicit solution_sink (std::vector< std::vector<int> > board_symmetries)
+      : board_symmetries (std::move(board_symmetries))
+    {}
+
+    tiling canonical (tiling const & t) const
+    {
+      tiling least (t), image (t.size());
+      for (std::vector<int> const & permutation : board_symmetries)
+	{
+	  for (std::size_t i=0; i != t.size(); ++i)
+	    image[permutation[i]] = t[i];
+	  if (image < least)
+	    least = image;
+	}
+      return least;
+    }
+
+    void add (tiling const & t)
+    {
+      tiling c = canonical(t);
+      std::lock_guard<std::mutex> lock (mutex);
+      ++n_solutions;
+      distinct_solutions.insert(std::move(c));
+    }
+
+    std::uint64_t count () const
+    { return n_solutions; }
+
+    std::set<tiling> const & distinct () const
+    { return distinct_solutions; }
+  };
+
+  inline tiling make_tiling (placement_table const & piece_coverage, int n_cells,
+			     std::vector<int> const & chosen)
+  {
+    tiling t (n_cells, '\0');
+    for (std::size_t pc = 0; pc != chosen.size(); ++pc)
+      for (int i : piece_coverage[pc][chosen[pc]])
+	t[i] = pc;
+    return t;
+  }
+
+  // Cuts the search tree into a task for each node down to split_depth
+  // placements, and runs them on the pool, each with its own board.
+  template <int Words>
+  search_stats enumerate_bitmask (placement_table const & piece_coverage, int n_cells,
+				  ad::work_stealing_pool & pool, int split_depth, solution_sink & sink,
+				  search_options const & options)
+  {
+    using search_type = bitmask_search<Words>;
+    using node = typename search_type::node;
+
+    search_type search = make_bitmask_search<Words>(piece_coverage, n_cells, options);
+    search_stats stats;
+    std::mutex stats_mutex;
+
+    std::function<void(node const &, int)> task = [&] (node const & n, int depth)
+      {
+	if (depth < split_depth
+	    && search.expand(n, [&] (node const & child)
+			     { pool.spawn([&task, child, depth] { task(child, depth + 1); }); }))
+	  {
+	    std::lock_guard<std::mutex> lock (stats_mutex);
+	    ++stats.nodes;
+	    stats.depth.add(depth);
+	    return;
+	  }
+
+	search_stats task_stats;
+	search.solve_from(n, [&] (std::vector<int> const & chosen)
+			  {
+			    sink.add(make_tiling(piece_coverage, n_cells, chosen));
+			    return true;
+			  }, task_stats);
+	std::lock_guard<std::mutex> lock (stats_mutex);
+	stats += task_stats;
+      };
+
+    pool.run([&] { task(search.root(), 0); });
+    search.add_table_counts(stats);
+    return stats;
+  }
+
+  // Passes every tiling with every piece to sink, and returns the work
+  // done.  Boards too large for a bitmask are searched with dancing
+  // links, on one thread.
+  search_stats enumerate (placement_table const & piece_coverage, int n_cells,
+			  ad::work_stealing_pool & pool, int split_depth, solution_sink & sink,
+			  search_options const & options)
+  {
+    if (options.use_dancing_links == false && int(piece_coverage.size()) <= bitmask_search<1>::max_pieces)
+      {
+	if (n_cells <= bitmask_search<1>::max_cells)
+	  return enumerate_bitmask<1>(piece_coverage, n_cells, pool, split_depth, sink, options);
+	if (n_cells <= bitmask_search<2>::max_cells)
+	  return enumerate_bitmask<2>(piece_coverage, n_cells, pool, split_depth, sink, options);
+	if (n_cells <= bitmask_search<4>::max_cells)
+	  return enumerate_bitmask<4>(piece_coverage, n_cells, pool, split_depth, sink, options);
+      }
+
+    return dancing_links_tilings(piece_coverage, n_cells, 0, [&] (std::vector<int> const & chosen)
+				 {
+				   sink.add(make_tiling(piece_coverage, n_cells, chosen));
+				   return true;
+				 });
+  }
+}
+
+#endif
@@ -0,0 +1,199 @@
+#ifndef AD_HEXUS_PLACEMENT_TABLE_HXX
+#define AD_HEXUS_PLACEMENT_TABLE_HXX
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ad::hexus
+{
+  // Every placement of every piece, as the cells each covers, in three flat
+  // arrays: where each piece's placements start, where each placement's
+  // cells start, and the cells.  The arrays are either built in memory or
+  // mapped from a file written by an earlier run; the file's header holds a
+  // signature of the board and pieces, so a table is never used for a
+  // different puzzle.
+  class placement_table
+  {
+    struct header
+    {
+      char magic[8];
+      std::uint64_t signature;
+      std::uint64_t n_pieces;
+      std::uint64_t n_placements;
+      std::uint64_t n_cells;
+    };
+
+    static constexpr char magic[8] = {'H', 'E', 'X', 'P', 'L', 'C', 'T', '1'};
+
+    std::vector<std::uint32_t> piece_store, placement_store;
+    std::vector<std::int32_t> cell_store;
+
+    std::uint32_t const * piece_first = nullptr;       // n_pieces + 1
+    std::uint32_t const * placement_first = nullptr;   // n_placements + 1
+    std::int32_t const * cells = nullptr;
+    std::size_t n_pieces = 0;
+
+    void * map = MAP_FAILED;
+    std::size_t map_size = 0;
+
+    void unmap ()
+    {
+      if (map != MAP_FAILED)
+	munmap(map, map_size);
+      map = MAP_FAILED;
+    }
+
+  public:
+    // The cells of one placement
+    class cell_range
+    {
+      std::int32_t const * first;
+      std::int32_t const * last;
+
+    public:
+      cell_range (std::int32_t const * first, std::int32_t const * last)
+	: first (first), last (last)
+      {}
+
+      std::int32_t const * begin () const { return first; }
+      std::int32_t const * end () const   { return last; }
+      std::size_t size () const           { return last - first; }
+    };
+
+    // The placements of one piece
+    class piece_view
+    {
+      placement_table const * table;
+      std::size_t piece;
+
+    public:
+      piece_view (placement_table const * table, std::size_t piece)
+	: table (table), piece (piece)
+      {}
+
+      std::size_t size () const
+      { return table -> piece_first[piece + 1] - table -> piece_first[piece]; }
+
+      bool empty () const
+      { return size() == 0; }
+
+      cell_range operator [] (std::size_t i) const
+      {
+	std::size_t p = table -> piece_first[piece] + i;
+	return cell_range (table -> cells + table -> placement_first[p],
+			   table -> cells + table -> placement_first[p + 1]);
+      }
+
+      cell_range front () const
+      { return (*this)[0]; }
+    };
+
+    placement_table () = default;
+    placement_table (placement_table const &) = delete;
+    placement_table & operator = (placement_table const &) = delete;
+
+    ~placement_table ()
+    { unmap(); }
+
+    // placements[p][i] lists the cells covered by the i-th placement of
+    // piece p.
+    void build (std::vector<std::vector<std::vector<int>>> const & placements)
+    {
+      unmap();
+      piece_store.assign(1, 0);
+      placement_store.assign(1, 0);
+      cell_store.clear();
+      for (auto const & piece : placements)
+	{
+	  for (auto const & placement : piece)
+	    {
+	      cell_store.insert(cell_store.end(), placement.begin(), placement.end());
+	      placement_store.push_back(cell_store.size());
+	    }
+	  piece_store.push_back(placement_store.size() - 1);
+	}
+
+      piece_first = piece_store.data();
+      placement_first = placement_store.data();
+      cells = cell_store.data();
+      n_pieces = placements.size();
+    }
+
+    // The number of pieces
+    std::size_t size () const
+    { return n_pieces; }
+
+    piece_view operator [] (std::size_t piece) const
+    { return piece_view (this, piece); }
+
+    bool write (std::string const & path, std::uint64_t signature) const
+    {
+      header h;
+      std::memcpy(h.magic, magic, sizeof(magic));
+      h.signature = signature;
+      h.n_pieces = n_pieces;
+      h.n_placements = piece_first[n_pieces];
+      h.n_cells = placement_first[h.n_placements];
+
+      std::FILE * file = std::fopen(path.c_str(), "wb");
+      if (file == nullptr)
+	return false;
+      bool ok = std::fwrite(&h, sizeof(h), 1, file) == 1
+	&& std::fwrite(piece_first, sizeof(std::uint32_t), h.n_pieces + 1, file) == h.n_pieces + 1
+	&& std::fwrite(placement_first, sizeof(std::uint32_t), h.n_placements + 1, file) == h.n_placements + 1
+	&& std::fwrite(cells, sizeof(std::int32_t), h.n_cells, file) == h.n_cells;
+      return std::fclose(file) == 0 && ok;
+    }
+
+    // Maps a table file.  Returns false if it is missing, damaged or was
+    // built for a different puzzle.
+    bool open (std::string const & path, std::uint64_t signature)
+    {
+      unmap();
+      int fd = ::open(path.c_str(), O_RDONLY);
+      if (fd < 0)
+	return false;
+      struct stat st;
+      if (fstat(fd, &st) == 0 && std::size_t(st.st_size) >= sizeof(header))
+	{
+	  map_size = st.st_size;
+	  map = mmap(nullptr, map_size, PROT_READ, MAP_SHARED, fd, 0);
+	}
+      ::close(fd);
+      if (map == MAP_FAILED)
+	return false;
+
+      header const & h = *static_cast<header const *>(map);
+      if (std::memcmp(h.magic, magic, sizeof(magic)) != 0 || h.signature != signature
+	  || map_size != sizeof(header) + (h.n_pieces + 1 + h.n_placements + 1) * sizeof(std::uint32_t)
+			 + h.n_cells * sizeof(std::int32_t))
+	{
+	  unmap();
+	  return false;
+	}
+
+      char const * data = static_cast<char const *>(map) + sizeof(header);
+      piece_first = reinterpret_cast<std::uint32_t const *>(data);
+      placement_first = piece_first + h.n_pieces + 1;
+      cells = reinterpret_cast<std::int32_t const *>(placement_first + h.n_placements + 1);
+      n_pieces = h.n_pieces;
+      if (piece_first[n_pieces] != h.n_placements || placement_first[h.n_placements] != h.n_cells)
+	{
+	  unmap();
+	  n_pieces = 0;
+	  return false;
+	}
+      return true;
+    }
+  };
+}
+
+#endif
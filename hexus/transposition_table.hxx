@@ -0,0 +1,117 @@
+#ifndef AD_HEXUS_TRANSPOSITION_TABLE_HXX
+#define AD_HEXUS_TRANSPOSITION_TABLE_HXX
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+
+#include <sys/mman.h>
+
+namespace ad::hexus
+{
+  // Positions of a search known to lead to no tiling, each as the cells
+  // covered and the pieces used, found by a Zobrist hash of the two.  The
+  // table holds as many as fit in a fixed number of bytes, in buckets of
+  // four.  A position stored in a full bucket evicts the one with the most
+  // pieces placed, as the search below it was the smallest.  Positions are
+  // compared in full, so a hash collision never makes a solvable position
+  // look failed.  The entries are mapped anonymously, so memory is only
+  // taken up as they are used.  Threads lock one of a number of stripes of
+  // buckets.
+  template <typename Mask>
+  class transposition_table
+  {
+    struct entry
+    {
+      Mask occupied;
+      std::uint64_t used = 0;
+      bool full = false;
+    };
+
+    static constexpr std::size_t ways = 4;
+    static constexpr std::size_t n_locks = 64;
+
+    entry * entries;               // all zero at first, which is empty
+    std::size_t n_entries;
+    std::size_t bucket_mask;
+    std::unique_ptr<std::mutex[]> locks;
+    std::atomic<std::uint64_t> n_stores {0}, n_evictions {0};
+
+    std::size_t bucket (std::uint64_t hash) const
+    { return hash & bucket_mask; }
+
+  public:
+    // Uses at most bytes for the entries, and at least one bucket
+    explicit transposition_table (std::size_t bytes)
+      : locks (new std::mutex[n_locks])
+    {
+      std::size_t n_buckets = 1;
+      while (2 * n_buckets * ways * sizeof(entry) <= bytes)
+	n_buckets *= 2;
+      n_entries = n_buckets * ways;
+      bucket_mask = n_buckets - 1;
+
+      void * map = mmap(nullptr, n_entries * sizeof(entry), PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (map == MAP_FAILED)
+	throw std::bad_alloc();
+      entries = static_cast<entry *>(map);
+    }
+
+    transposition_table (transposition_table const &) = delete;
+    transposition_table & operator = (transposition_table const &) = delete;
+
+    ~transposition_table ()
+    { munmap(entries, n_entries * sizeof(entry)); }
+
+    bool contains (std::uint64_t hash, Mask const & occupied, std::uint64_t used) const
+    {
+      std::size_t b = bucket(hash);
+      std::lock_guard<std::mutex> lock (locks[b % n_locks]);
+      for (std::size_t i = b * ways; i != (b + 1) * ways; ++i)
+	{
+	  entry const & e = entries[i];
+	  if (e.full && e.used == used && e.occupied == occupied)
+	    return true;
+	}
+      return false;
+    }
+
+    void insert (std::uint64_t hash, Mask const & occupied, std::uint64_t used)
+    {
+      std::size_t b = bucket(hash);
+      std::lock_guard<std::mutex> lock (locks[b % n_locks]);
+      entry * victim = nullptr;
+      for (std::size_t i = b * ways; i != (b + 1) * ways; ++i)
+	{
+	  entry & e = entries[i];
+	  if (e.full == false)
+	    {
+	      victim = &e;
+	      break;
+	    }
+	  if (victim == nullptr || __builtin_popcountll(e.used) > __builtin_popcountll(victim -> used))
+	    victim = &e;
+	}
+      if (victim -> full)
+	++n_evictions;
+      ++n_stores;
+      *victim = entry {occupied, used, true};
+    }
+
+    std::uint64_t stores () const
+    { return n_stores; }
+
+    std::uint64_t evictions () const
+    { return n_evictions; }
+
+    // The most positions it holds
+    std::size_t capacity () const
+    { return n_entries; }
+  };
+}
+
+#endif
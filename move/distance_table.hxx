@@ -0,0 +1,270 @@
+#ifndef AD_MOVE_DISTANCE_TABLE_HXX
+#define AD_MOVE_DISTANCE_TABLE_HXX
+
+#include "move.hxx"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ad::move
+{
+  /////////////
+  // unslide //
+  /////////////
+
+  // Calls f(p) for every state p with slide(p, dir) == k.
+  //
+  // Sliding is not reversible: a dot stopped by a wall may have been there
+  // already or may have just arrived, and a dot that stopped behind a
+  // stopped dot may have done either too.  The dots are decided front first,
+  // as in slide(): a dot with an empty square ahead must have moved, as must
+  // a dot whose blocker moved; otherwise both are tried.  Each candidate is
+  // then checked with slide(), so only true predecessors are reported.
+  template <typename F>
+  void unslide (key k, codec const & c, slide_table const & t, int dir, F f)
+  {
+    std::uint32_t dots[128];
+    bool moved[128];
+    int n = c.n_dots;
+    c.unpack(k, dots);
+
+    bool forward = dir == 1 || dir == 3;
+    int back = dir ^ 1;
+
+    auto ahead_of = [&] (int cell) -> int
+      {
+	int next = t.step(cell, dir);
+	if (next < 0)
+	  return -1;
+	std::uint32_t * a = std::lower_bound(dots, dots + n, c.make_dot(next, 0));
+	return (a != dots + n && c.cell_of_dot(*a) == next) ? a - dots : n;
+      };
+
+    auto decide = [&] (auto & self, int j) -> void
+      {
+	if (j == n)
+	  {
+	    std::uint32_t origin[128];
+	    for (int i=0; i != n; ++i)
+	      origin[i] = moved[i] ? c.make_dot(t.step(c.cell_of_dot(dots[i]), back), c.colour_of_dot(dots[i]))
+				   : dots[i];
+	    std::sort(origin, origin + n);
+	    for (int i=1; i < n; ++i)
+	      if (c.cell_of_dot(origin[i-1]) == c.cell_of_dot(origin[i]))
+		return;
+	    key p = c.pack(origin);
+	    if (slide(p, c, t, dir) == k)
+	      f(p);
+	    return;
+	  }
+
+	int i = forward ? n-1-j : j;
+	int cell = c.cell_of_dot(dots[i]);
+	int ahead = ahead_of(cell);   // -1 for a wall, n for an empty square
+
+	bool can_stay = ahead < 0 || (ahead < n && moved[ahead] == false);
+	bool can_move = t.step(cell, back) >= 0;
+
+	if (can_stay)
+	  {
+	    moved[i] = false;
+	    self(self, j+1);
+	  }
+	if (can_move)
+	  {
+	    moved[i] = true;
+	    self(self, j+1);
+	  }
+      };
+    decide(decide, 0);
+  }
+
+  ////////////////////
+  // distance table //
+  ////////////////////
+
+  // Searches backwards from every solved state at once, and records for
+  // each state that can be solved its distance from a solution and the first
+  // move of a shortest one.  colour_counts gives the number of dots of each
+  // colour index.
+  visited_table retrograde_search (codec const & c, slide_table const & t,
+				   std::vector<int> const & colour_counts, int n_cells)
+  {
+    visited_table table;
+    std::vector<key> level;
+
+    // Every way of putting each colour's dots on that colour's goals
+    std::vector<std::vector<int>> goals (colour_counts.size());
+    for (int cell=0; cell != n_cells; ++cell)
+      if (t.goal_of(cell) >= 0)
+	goals[t.goal_of(cell)].push_back(cell);
+
+    std::vector<std::uint32_t> chosen;
+    auto place = [&] (auto & self, std::size_t colour, std::size_t from, int left) -> void
+      {
+	if (colour == colour_counts.size())
+	  {
+	    std::vector<std::uint32_t> dots (chosen);
+	    std::sort(dots.begin(), dots.end());
+	    key k = c.pack(dots.data());
+	    if (table.insert(k, k, '\0', 0))
+	      level.push_back(k);
+	    return;
+	  }
+	if (left == 0)
+	  {
+	    std::size_t next = colour + 1;
+	    self(self, next, 0, next < colour_counts.size() ? colour_counts[next] : 0);
+	    return;
+	  }
+	for (std::size_t g = from; g < goals[colour].size(); ++g)
+	  {
+	    chosen.push_back(c.make_dot(goals[colour][g], colour));
+	    self(self, colour, g + 1, left - 1);
+	    chosen.pop_back();
+	  }
+      };
+    if (colour_counts.empty() == false)
+      place(place, 0, 0, colour_counts[0]);
+
+    for (int depth = 1; level.empty() == false; ++depth)
+      {
+	std::vector<key> next_level;
+	for (key s : level)
+	  for (int d=0; d != 4; ++d)
+	    unslide(s, c, t, d, [&] (key p)
+	      {
+		if (table.insert(p, s, directions[d], depth))
+		  next_level.push_back(p);
+	      });
+	level.swap(next_level);
+      }
+    return table;
+  }
+
+  // The result of a retrograde search, as a file of records sorted by state
+  // which is mapped into memory to be queried.  The header holds a signature
+  // of the board and dot colours, so a table is never used for a different
+  // puzzle.
+  class distance_table
+  {
+    struct header
+    {
+      char magic[8];
+      std::uint64_t signature;
+      std::uint64_t count;
+    };
+
+    struct record
+    {
+      std::uint64_t state[2];
+      std::uint16_t distance;
+      char move;
+    };
+
+    void * map = MAP_FAILED;
+    std::size_t map_size = 0;
+    record const * records = nullptr;
+    std::size_t count = 0;
+
+    static constexpr char magic[8] = {'M', 'O', 'V', 'E', 'T', 'B', 'L', '1'};
+
+    static bool less (record const & r, key k)
+    {
+      std::uint64_t hi = k >> 64, lo = k;
+      return r.state[1] != hi ? r.state[1] < hi : r.state[0] < lo;
+    }
+
+  public:
+    distance_table () = default;
+    distance_table (distance_table const &) = delete;
+    distance_table & operator = (distance_table const &) = delete;
+
+    ~distance_table ()
+    {
+      if (map != MAP_FAILED)
+	munmap(map, map_size);
+    }
+
+    static bool write (std::string const & path, std::uint64_t signature, visited_table const & table)
+    {
+      std::vector<record> out;
+      out.reserve(table.size());
+      table.for_each([&] (key state, key, char move, int depth)
+	{ out.push_back(record {{std::uint64_t(state), std::uint64_t(state >> 64)}, std::uint16_t(depth), move}); });
+      std::sort(out.begin(), out.end(), [] (record const & a, record const & b)
+	{ return a.state[1] != b.state[1] ? a.state[1] < b.state[1] : a.state[0] < b.state[0]; });
+
+      header h;
+      std::memcpy(h.magic, magic, sizeof(magic));
+      h.signature = signature;
+      h.count = out.size();
+
+      std::FILE * file = std::fopen(path.c_str(), "wb");
+      if (file == nullptr)
+	return false;
+      bool ok = std::fwrite(&h, sizeof(h), 1, file) == 1
+	&& std::fwrite(out.data(), sizeof(record), out.size(), file) == out.size();
+      return std::fclose(file) == 0 && ok;
+    }
+
+    // Maps a table file.  Returns false if it is missing, damaged or was
+    // built for a different puzzle.
+    bool open (std::string const & path, std::uint64_t signature)
+    {
+      int fd = ::open(path.c_str(), O_RDONLY);
+      if (fd < 0)
+	return false;
+      struct stat st;
+      if (fstat(fd, &st) == 0 && std::size_t(st.st_size) >= sizeof(header))
+	{
+	  map_size = st.st_size;
+	  map = mmap(nullptr, map_size, PROT_READ, MAP_SHARED, fd, 0);
+	}
+      ::close(fd);
+      if (map == MAP_FAILED)
+	return false;
+
+      header const & h = *static_cast<header const *>(map);
+      if (std::memcmp(h.magic, magic, sizeof(magic)) != 0 || h.signature != signature
+	  || map_size != sizeof(header) + h.count * sizeof(record))
+	{
+	  munmap(map, map_size);
+	  map = MAP_FAILED;
+	  return false;
+	}
+      records = reinterpret_cast<record const *>(static_cast<char const *>(map) + sizeof(header));
+      count = h.count;
+      return true;
+    }
+
+    std::size_t size () const
+    { return count; }
+
+    // Follows the recorded moves from start to a solution.  Returns false if
+    // start cannot be solved.
+    bool solve (key start, codec const & c, slide_table const & t, std::string & moves) const
+    {
+      moves.clear();
+      for (key k = start; ; )
+	{
+	  record const * r = std::lower_bound(records, records + count, k, less);
+	  if (r == records + count || r -> state[0] != std::uint64_t(k) || r -> state[1] != std::uint64_t(k >> 64))
+	    return false;
+	  if (r -> distance == 0)
+	    return true;
+	  moves.push_back(r -> move);
+	  k = slide(k, c, t, std::strchr(directions, r -> move) - directions);
+	}
+    }
+  };
+}
+
+#endif
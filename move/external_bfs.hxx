@@ -0,0 +1,391 @@
+#ifndef AD_MOVE_EXTERNAL_BFS_HXX
+#define AD_MOVE_EXTERNAL_BFS_HXX
+
+#include "move.hxx"
+#include "distance_table.hxx"
+
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ad::move
+{
+  ///////////////
+  // key files //
+  ///////////////
+
+  // A file of keys, one after another, each in its lowest bytes bytes,
+  // least significant first.  Keys of a few dots fit in far fewer bytes
+  // than a key holds.
+  class key_writer
+  {
+    std::FILE * file;
+    int bytes;
+
+  public:
+    key_writer (std::string const & path, int bytes)
+      : file (std::fopen(path.c_str(), "wb")), bytes (bytes)
+    {
+      if (file != nullptr)
+	std::setvbuf(file, nullptr, _IOFBF, 1 << 16);
+    }
+
+    key_writer (key_writer const &) = delete;
+    key_writer & operator = (key_writer const &) = delete;
+
+    ~key_writer ()
+    { close(); }
+
+    bool is_open () const
+    { return file != nullptr; }
+
+    bool put (key k)
+    {
+      unsigned char buffer[sizeof(key)];
+      for (int i=0; i != bytes; ++i)
+	buffer[i] = std::uint8_t(k >> (8 * i));
+      return std::fwrite(buffer, bytes, 1, file) == 1;
+    }
+
+    // Returns false if the file could not be written
+    bool close ()
+    {
+      bool ok = file != nullptr && std::fclose(file) == 0;
+      file = nullptr;
+      return ok;
+    }
+  };
+
+  // Reads a file of keys from the start
+  class key_reader
+  {
+    std::FILE * file;
+    int bytes;
+
+  public:
+    key_reader (std::string const & path, int bytes)
+      : file (std::fopen(path.c_str(), "rb")), bytes (bytes)
+    {
+      if (file != nullptr)
+	std::setvbuf(file, nullptr, _IOFBF, 1 << 16);
+    }
+
+    key_reader (key_reader const &) = delete;
+    key_reader & operator = (key_reader const &) = delete;
+
+    ~key_reader ()
+    {
+      if (file != nullptr)
+	std::fclose(file);
+    }
+
+    bool is_open () const
+    { return file != nullptr; }
+
+    // Returns false at the end of the file
+    bool next (key & k)
+    {
+      unsigned char buffer[sizeof(key)];
+      if (std::fread(buffer, bytes, 1, file) != 1)
+	return false;
+      k = 0;
+      for (int i = bytes; i-- > 0; )
+	k = (k << 8) | buffer[i];
+      return true;
+    }
+  };
+
+  // A sorted file of keys, searched in place
+  class sorted_key_file
+  {
+    int fd;
+    int bytes;
+    std::size_t count = 0;
+
+    key at (std::size_t i) const
+    {
+      unsigned char buffer[sizeof(key)];
+      if (pread(fd, buffer, bytes, off_t(i) * bytes) != bytes)
+	return 0;
+      key k = 0;
+      for (int j = bytes; j-- > 0; )
+	k = (k << 8) | buffer[j];
+      return k;
+    }
+
+  public:
+    sorted_key_file (std::string const & path, int bytes)
+      : fd (::open(path.c_str(), O_RDONLY)), bytes (bytes)
+    {
+      struct stat st;
+      if (fd >= 0 && fstat(fd, &st) == 0)
+	count = st.st_size / bytes;
+    }
+
+    sorted_key_file (sorted_key_file const &) = delete;
+    sorted_key_file & operator = (sorted_key_file const &) = delete;
+
+    ~sorted_key_file ()
+    {
+      if (fd >= 0)
+	::close(fd);
+    }
+
+    bool contains (key k) const
+    {
+      std::size_t lo = 0, hi = count;
+      while (lo < hi)
+	{
+	  std::size_t mid = lo + (hi - lo) / 2;
+	  if (at(mid) < k)
+	    lo = mid + 1;
+	  else
+	    hi = mid;
+	}
+      return lo < count && at(lo) == k;
+    }
+  };
+
+  // Calls f(k) for each key in a set of sorted files, in order, once each
+  // however many files hold it.  Returns false if a file cannot be read.
+  template <typename F>
+  bool merge_sorted (std::vector<std::string> const & paths, int bytes, F f)
+  {
+    std::vector<std::unique_ptr<key_reader>> readers;
+    using item = std::pair<key, std::size_t>;
+    std::priority_queue<item, std::vector<item>, std::greater<item>> heads;
+    for (std::string const & path : paths)
+      {
+	readers.push_back(std::make_unique<key_reader>(path, bytes));
+	if (readers.back() -> is_open() == false)
+	  return false;
+	key k;
+	if (readers.back() -> next(k))
+	  heads.emplace(k, readers.size() - 1);
+      }
+
+    key last = 0;   // no key is zero
+    while (heads.empty() == false)
+      {
+	auto [k, i] = heads.top();
+	heads.pop();
+	if (k != last)
+	  f(k);
+	last = k;
+	if (readers[i] -> next(k))
+	  heads.emplace(k, i);
+      }
+    return true;
+  }
+
+  /////////////////////
+  // external search //
+  /////////////////////
+
+  struct external_options
+  {
+    // Where the level files go, in a directory of their own which is
+    // removed at the end
+    std::string directory = "/tmp";
+
+    // Roughly the most memory to use, most of it for sorting new states
+    std::size_t memory_bytes = std::size_t(256) << 20;
+  };
+
+  // Breadth first search with the levels on disk, so that memory stays
+  // bounded however many states there are.  Each level is a sorted file of
+  // the states first reached in that many moves.  The next level is made by
+  // sliding every state of the last one, sorting the results in runs that
+  // fit in memory, and merging the runs while dropping any state found in a
+  // level before (delayed duplicate detection).  Since moves cannot always
+  // be undone, every earlier level is checked, not just the last two.
+  //
+  // No parent links are kept.  Once a level holds a solved state, the moves
+  // are found by working back through the levels: for each state, its
+  // predecessors are generated with unslide() and looked up in the level
+  // before.  The solution is as short as any.
+  //
+  // Fills r and returns true, or returns false if the files cannot be
+  // written.
+  bool solve_external_bfs (key start, codec const & c, slide_table const & t,
+			   external_options const & options, search_result & r)
+  {
+    r = search_result();
+
+    std::string pattern = options.directory + "/move-bfs-XXXXXX";
+    std::vector<char> dir (pattern.begin(), pattern.end());
+    dir.push_back('\0');
+    if (mkdtemp(dir.data()) == nullptr)
+      return false;
+    std::string const directory = dir.data();
+
+    auto level_path = [&] (int depth) { return directory + "/level-" + std::to_string(depth); };
+    auto run_path = [&] (std::size_t run) { return directory + "/run-" + std::to_string(run); };
+
+    // The marker bit above the last dot is part of the key
+    int const bytes = (c.n_dots * c.dot_bits + 1 + 7) / 8;
+    std::size_t const buffer_keys = std::max<std::size_t>(1024, options.memory_bytes / 2 / sizeof(key));
+    std::size_t const max_runs = 256;
+
+    int depth = 0;
+    key goal = 0;
+    bool ok;
+    {
+      key_writer level (level_path(0), bytes);
+      ok = level.is_open() && level.put(start) && level.close();
+    }
+    r.visited = 1;
+    if (solved(start, c, t))
+      goal = start;
+
+    std::vector<key> buffer;
+    std::vector<std::string> runs;
+    std::size_t level_size = 1;
+    while (ok && goal == 0 && level_size != 0)
+      {
+	// Slide every state of the last level into sorted runs
+	auto write_run = [&] ()
+	  {
+	    std::sort(buffer.begin(), buffer.end());
+	    buffer.erase(std::unique(buffer.begin(), buffer.end()), buffer.end());
+	    runs.push_back(run_path(runs.size()));
+	    key_writer run (runs.back(), bytes);
+	    bool written = run.is_open();
+	    for (key k : buffer)
+	      written = written && run.put(k);
+	    buffer.clear();
+	    return run.close() && written;
+	  };
+
+	std::uint64_t successors = 0;
+	buffer.reserve(buffer_keys);
+	{
+	  key_reader level (level_path(depth), bytes);
+	  ok = level.is_open();
+	  for (key k; ok && level.next(k); )
+	    {
+	      ++r.expanded;
+	      for (int d=0; d != 4; ++d)
+		buffer.push_back(slide(k, c, t, d));
+	      successors += 4;
+	      if (buffer.size() + 4 > buffer_keys)
+		ok = write_run();
+	    }
+	}
+	if (ok && buffer.empty() == false)
+	  ok = write_run();
+	std::vector<key> ().swap(buffer);
+
+	// Too many runs to read at once are merged into fewer first
+	while (ok && runs.size() > max_runs)
+	  {
+	    std::vector<std::string> group (runs.end() - max_runs, runs.end());
+	    runs.resize(runs.size() - max_runs);
+	    std::string merged = run_path(runs.size()) + "-merged";
+	    key_writer out (merged, bytes);
+	    bool written = out.is_open();
+	    ok = merge_sorted(group, bytes, [&] (key k) { written = written && out.put(k); });
+	    ok = out.close() && written && ok;
+	    for (std::string const & path : group)
+	      std::remove(path.c_str());
+	    std::string renamed = run_path(runs.size());
+	    ok = ok && std::rename(merged.c_str(), renamed.c_str()) == 0;
+	    runs.push_back(renamed);
+	  }
+
+	// Merge the runs, keeping the states in no earlier level
+	std::vector<std::unique_ptr<key_reader>> earlier;
+	std::vector<key> earlier_head;
+	for (int d = 0; ok && d <= depth; ++d)
+	  {
+	    earlier.push_back(std::make_unique<key_reader>(level_path(d), bytes));
+	    earlier_head.push_back(0);
+	    ok = earlier.back() -> is_open();
+	    if (ok && earlier.back() -> next(earlier_head.back()) == false)
+	      earlier_head.back() = ~key(0);
+	  }
+	auto seen = [&] (key k)
+	  {
+	    bool found = false;
+	    for (std::size_t d=0; d != earlier.size(); ++d)
+	      {
+		while (earlier_head[d] < k)
+		  if (earlier[d] -> next(earlier_head[d]) == false)
+		    earlier_head[d] = ~key(0);
+		found = found || earlier_head[d] == k;
+	      }
+	    return found;
+	  };
+
+	level_size = 0;
+	if (ok)
+	  {
+	    key_writer next (level_path(depth + 1), bytes);
+	    bool written = next.is_open();
+	    ok = merge_sorted(runs, bytes, [&] (key k)
+	      {
+		if (seen(k))
+		  return;
+		written = written && next.put(k);
+		++level_size;
+		if (goal == 0 && solved(k, c, t))
+		  goal = k;
+	      });
+	    ok = next.close() && written && ok;
+	  }
+	earlier.clear();
+	for (std::string const & path : runs)
+	  std::remove(path.c_str());
+	runs.clear();
+
+	++depth;
+	r.visited += level_size;
+	r.duplicates += successors - level_size;
+	r.peak_frontier.at_least(level_size);
+      }
+    r.peak_visited.at_least(r.visited);
+
+    // Work back from the goal, one level at a time
+    if (ok && goal != 0)
+      {
+	r.found = true;
+	key k = goal;
+	for (int d = depth - 1; d >= 0 && ok; --d)
+	  {
+	    sorted_key_file level (level_path(d), bytes);
+	    key parent = 0;
+	    char move = '\0';
+	    for (int dir = 0; dir != 4 && parent == 0; ++dir)
+	      unslide(k, c, t, dir, [&] (key p)
+		{
+		  if (parent == 0 && level.contains(p))
+		    {
+		      parent = p;
+		      move = directions[dir];
+		    }
+		});
+	    ok = parent != 0;
+	    r.moves.push_back(move);
+	    k = parent;
+	  }
+	std::reverse(r.moves.begin(), r.moves.end());
+      }
+
+    for (int d = 0; d <= depth; ++d)
+      std::remove(level_path(d).c_str());
+    rmdir(directory.c_str());
+    return ok;
+  }
+}
+
+#endif
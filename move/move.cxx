@@ -1,231 +1,194 @@
+#include "move.hxx"
+#include "distance_table.hxx"
+#include "external_bfs.hxx"
+#include "../common/batch.hxx"
+
 #include <algorithm>
+#include <chrono>
+#include <cstdlib>
 #include <iostream>
-#include <list>
-#include <map>
-#include <queue>
-#include <vector>
+#include <string>
 
-//////////////
-// generics //
-//////////////
+using namespace ad::move;
 
-template <typename A, typename B>
-std::istream & operator >> (std::istream & is, std::pair<A,B> & p)
+// Answers every gamestate on the input from a distance table, building the
+// table first if the file is missing or was built for another puzzle.
+int solve_from_table (std::string const & path, board const & b, gamestate gs)
 {
-  return is >> p.first >> p.second;
-}
-
-/////////////
-// colours //
-/////////////
+  codec c (b, gs);
+  slide_table t (b, c);
+  std::uint64_t sig = signature(b, gs);
 
-std::string colour (char c)
-{
-  switch (c)
+  distance_table table;
+  if (table.open(path, sig) == false)
     {
-    case 'r': return "\e[31m";
-    case 'g': return "\e[32m";
-    case 'y': return "\e[33m";
-    case 'b': return "\e[36m";
-    case 'o': return "\e[37m";
-    default:  return "\e[39m";
-    }
-}
-
-///////////
-// board //
-///////////
+      std::vector<int> colour_counts (c.n_colours(), 0);
+      for (auto const & dot : gs)
+	++colour_counts[c.colour_index(dot.second)];
 
-using location = std::pair<int,int>;
-
-location operator + (location const & a, location const & b)
-{
-  return location {a.first + b.first, a.second + b.second};
-}
-
-class board
-{
-  std::string grid;
-public:
-  int height, width;
-
-  char at (location const & l) const
-  { return grid[l.first*width + l.second]; }
+      visited_table states = retrograde_search(c, t, colour_counts, b.cells.size());
+      std::cerr << states.size() << " solvable states\n";
+      if (distance_table::write(path, sig, states) == false || table.open(path, sig) == false)
+	{
+	  std::cerr << "could not write " << path << '\n';
+	  return 1;
+	}
+    }
 
-  char at (int h, int w) const
-  { return grid[h*width + w]; }
+  do
+    {
+      if (signature(b, gs) != sig)
+	{
+	  std::cerr << "these dots do not match the table.\n";
+	  return 1;
+	}
 
-  friend std::istream & operator >> (std::istream & is, board & b);
-};
+      auto begin = std::chrono::steady_clock::now();
+      std::string moves;
+      bool found = table.solve(c.encode(gs), c, t, moves);
+      auto end = std::chrono::steady_clock::now();
 
-std::istream & operator >> (std::istream & is, board & b)
-{
-  is >> b.height >> b.width;
-  for (int i=0; i != b.height * b.width; ++i)
-    {
-      char c;
-      is >> c;
-      b.grid.push_back(c);
-    }
-  return is;
-}
+      if (found == false)
+	std::cout << "no solution.\n";
+      else
+	std::cout << "a solution was found:\t" << moves << '\n';
+      std::cerr << "answered in "
+		<< std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count() << " us\n";
 
-std::ostream & operator << (std::ostream & os, board const & b)
-{
-  for (int h=0; h != b.height; ++h)
-    {
-      for (int w=0; w != b.width; ++w)
-	os << b.at(h,w);
-      os << '\n';
+      gs.clear();
     }
-  return os;
+  while (std::cin >> gs);
+  return 0;
 }
 
-///////////
-// other //
-///////////
-
-bool inbounds (location const & l, board const & b)
+// One puzzle of a batch: a board, then its dots
+struct puzzle
 {
-  return (l.first >= 0  && l.first < b.height &&
-	  l.second >= 0 && l.second < b.width);
-}
-
-///////////////
-// gamestate //
-///////////////
-
-using gamestate = std::map<location, char>;
+  board b;
+  gamestate gs;
+};
 
-std::istream & operator >> (std::istream & is, gamestate & gs)
+template <typename Input>
+Input & operator >> (Input & is, puzzle & p)
 {
-  int tokens;
-  is >> tokens;
-  for (int t=0; t != tokens; ++t)
-    {
-      std::pair<location, char> token;
-      is >> token;
-      gs.insert(token);
-    }
-  return is;
+  return is >> p.b >> p.gs;
 }
 
-std::ostream & operator << (std::ostream & os, gamestate const & gs)
+void print_result (std::ostream & os, search_result const & r)
 {
-  for (std::pair<location,char> const & token : gs)
-    os << colour(token.second)
-       << "(" << token.first.first << ", " << token.first.second << ")"
-       << colour('\0') << '\n';
-  return os;
+  if (r.found == false)
+    os << "no solution.\n";
+  else
+    os << "a solution was found:\t" << r.moves << '\n';
 }
 
-gamestate slide (gamestate gs, board const & b, char d)
+int main (int argc, char ** argv)
 {
-  location dir = [] (char d) {
-    switch (d)
+  // -a searches with A* instead of breadth first
+  // -j N runs the breadth first search on N threads
+  // -t FILE answers from a table of every solvable state, built if needed
+  // -b solves every puzzle in the input, one after another, N at once with -j
+  // -i FILE reads the batch from a file instead of stdin
+  // -e DIR searches breadth first with the levels in files under DIR
+  // -M MB keeps the search with -e to about MB megabytes of memory
+  // -m writes the search's metrics to stderr as JSON
+  bool astar = false;
+  int threads = 1;
+  std::string table_path;
+  bool batch = false;
+  std::string input_path;
+  bool metrics = false;
+  bool external = false;
+  external_options external_opts;
+  for (int a=1; a < argc; ++a)
+    if (std::string(argv[a]) == "-a")
+      astar = true;
+    else if (std::string(argv[a]) == "-j" && a+1 < argc)
+      threads = std::atoi(argv[++a]);
+    else if (std::string(argv[a]) == "-t" && a+1 < argc)
+      table_path = argv[++a];
+    else if (std::string(argv[a]) == "-b")
+      batch = true;
+    else if (std::string(argv[a]) == "-i" && a+1 < argc)
+      input_path = argv[++a];
+    else if (std::string(argv[a]) == "-m")
+      metrics = true;
+    else if (std::string(argv[a]) == "-e" && a+1 < argc)
       {
-      case 'u': return location {-1,  0};
-      case 'd': return location { 1,  0};
-      case 'l': return location { 0, -1};
-      case 'r': return location { 0,  1};
-      default:  return location { 0,  0};
+	external = true;
+	external_opts.directory = argv[++a];
       }
-  } (d);
+    else if (std::string(argv[a]) == "-M" && a+1 < argc)
+      external_opts.memory_bytes = std::atof(argv[++a]) * (1 << 20);
 
-  gamestate new_gs;
-  while (gs.empty() == false)
+  if (batch)
     {
-      for (auto iter = gs.begin(); iter != gs.end(); )
+      ad::scanner in;
+      if (input_path.empty() ? in.read_all(0) == false : in.open(input_path) == false)
 	{
-	  location new_loc = iter -> first + dir;
-	  if (inbounds(new_loc, b) == false || b.at(new_loc) == 'x' || new_gs.count(new_loc) == 1)
-	    {
-	      new_gs.emplace(iter -> first, iter -> second);
-	      iter = gs.erase(iter);
-	    }
-	  else if (gs.count(new_loc) == 0)
-	    {
-	      new_gs.emplace(new_loc, iter -> second);
-	      iter = gs.erase(iter);
-	    }
-	  else
-	    ++iter;
+	  std::cerr << "cannot read " << (input_path.empty() ? "stdin" : input_path) << ".\n";
+	  return 1;
 	}
-    }
-
-  return new_gs;
-}
-
-bool solved (gamestate const & gs, board const & b)
-{
-  return std::all_of (gs.begin(), gs.end(),
-		      [&] (std::pair<location, char> const & piece)
-		      { return b.at(piece.first) == piece.second; });
-}
-
-void print_board (std::ostream & os, board const & b, gamestate const & gs)
-{
-  for (int h=0; h != b.height; ++h)
-    {
-      for (int w=0; w != b.width; ++w)
+      ad::thread_pool pool (threads);
+      bool ok = ad::run_batch<puzzle>(in, pool, std::cout, [&] (puzzle const & p, std::ostream & os)
 	{
-	  location l {h,w};
-
-	  if (b.at(l) == 'x')
-	    os << "[=]";
-	  else
+	  codec c (p.b, p.gs);
+	  if (c.fits() == false)
 	    {
-	      os << colour(b.at(l)) << (b.at(l) == '.' ? ' ' : '<')
-		 << (gs.count(l) == 1 ? colour(gs.at(l)) + "O" : " ")
-		 << colour(b.at(l)) << (b.at(l) == '.' ? ' ' : '>')
-		 << colour('\0');
+	      os << "too many dots to pack into a " << sizeof(key) * 8 << "-bit state.\n";
+	      return;
 	    }
-	}
-      os << '\n';
+	  slide_table t (p.b, c);
+	  key start = c.encode(p.gs);
+	  print_result(os, astar ? solve_astar(start, c, t, goal_distance (p.b, c, t)) : solve_bfs(start, c, t));
+	});
+      return ok ? 0 : 1;
     }
-}
 
-int main ()
-{
   board b;
   std::cin >> b;
 
   gamestate gs;
   std::cin >> gs;
 
-  std::queue<gamestate> node_queue;
-  node_queue.push(gs);
-  std::map<gamestate, std::pair<gamestate,char>> whence_map;
-  whence_map[gs] = std::make_pair(gs, '\0');
+  codec c (b, gs);
+  if (c.fits() == false)
+    {
+      std::cerr << "too many dots to pack into a " << sizeof(key) * 8 << "-bit state.\n";
+      return 1;
+    }
+
+  if (table_path.empty() == false)
+    return solve_from_table(table_path, b, gs);
 
-  while (node_queue.empty() == false && solved(node_queue.front(), b) == false)
+  slide_table t (b, c);
+  key start = c.encode(gs);
+
+  search_result r;
+  if (external)
     {
-      for (char d : std::string("udlr"))
+      if (solve_external_bfs(start, c, t, external_opts, r) == false)
 	{
-	  gamestate next_gs = slide (node_queue.front(), b, d);
-	  if (whence_map.count(next_gs) == 0)
-	    {
-	      node_queue.push(next_gs);
-	      whence_map.emplace(next_gs, std::make_pair(node_queue.front(), d));
-	    }
+	  std::cerr << "cannot write the search's files under " << external_opts.directory << ".\n";
+	  return 1;
 	}
-      node_queue.pop();
     }
-
-  if (node_queue.empty())
-    std::cout << "no solution.\n";
+  else if (astar)
+    r = solve_astar(start, c, t, goal_distance (b, c, t));
+  else if (threads > 1)
+    {
+      ad::thread_pool pool (threads);
+      r = solve_parallel_bfs(start, c, t, pool);
+    }
   else
+    r = solve_bfs(start, c, t);
+
+  std::cerr << r.visited << " states visited, " << r.expanded << " expanded\n";
+  if (metrics)
     {
-      std::cout << "a solution was found:\t";
-      std::list<char> solution;
-      gamestate s = node_queue.front();
-      while (whence_map[s].second != '\0')
-	{
-	  solution.push_front(whence_map[s].second);
-	  s = whence_map[s].first;
-	}
-      for (char c : solution)
-	std::cout << c;
-      std::cout << '\n';
+      ad::json_writer j (std::cerr);
+      write_metrics(j, r);
     }
+
+  print_result(std::cout, r);
 }
@@ -0,0 +1,862 @@
+#ifndef AD_MOVE_HXX
+#define AD_MOVE_HXX
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <vector>
+
+#include "../common/metrics.hxx"
+#include "../common/thread_pool.hxx"
+
+namespace ad::move
+{
+  //////////////
+  // generics //
+  //////////////
+
+  template <typename A, typename B>
+  std::istream & operator >> (std::istream & is, std::pair<A,B> & p)
+  {
+    return is >> p.first >> p.second;
+  }
+
+  /////////////
+  // colours //
+  /////////////
+
+  std::string colour (char c)
+  {
+    switch (c)
+      {
+      case 'r': return "\e[31m";
+      case 'g': return "\e[32m";
+      case 'y': return "\e[33m";
+      case 'b': return "\e[36m";
+      case 'o': return "\e[37m";
+      default:  return "\e[39m";
+      }
+  }
+
+  ///////////
+  // board //
+  ///////////
+
+  using location = std::pair<int,int>;
+
+  location operator + (location const & a, location const & b)
+  {
+    return location {a.first + b.first, a.second + b.second};
+  }
+
+  class board
+  {
+    std::string grid;
+  public:
+    int height, width;
+
+    // Every square that is not a wall is numbered in row-major order
+    std::vector<int> cell_index;      // grid position -> cell, or -1 for walls
+    std::vector<location> cells;      // cell -> location
+
+    char at (location const & l) const
+    { return grid[l.first*width + l.second]; }
+
+    char at (int h, int w) const
+    { return grid[h*width + w]; }
+
+    int index (location const & l) const
+    { return cell_index[l.first*width + l.second]; }
+
+    // A hash of the dimensions and every square
+    std::uint64_t fingerprint () const
+    {
+      std::uint64_t h = 1469598103934665603u;
+      for (char c : std::to_string(height) + 'x' + std::to_string(width) + grid)
+	h = (h ^ (unsigned char)(c)) * 1099511628211u;
+      return h;
+    }
+
+    // Reads from a std::istream or an ad::scanner
+    template <typename Input>
+    friend Input & operator >> (Input & is, board & b);
+  };
+
+  template <typename Input>
+  Input & operator >> (Input & is, board & b)
+  {
+    is >> b.height >> b.width;
+    for (int i=0; i != b.height * b.width; ++i)
+      {
+	char c;
+	is >> c;
+	b.grid.push_back(c);
+      }
+
+    for (int h=0; h != b.height; ++h)
+      for (int w=0; w != b.width; ++w)
+	if (b.at(h,w) == 'x')
+	  b.cell_index.push_back(-1);
+	else
+	  {
+	    b.cell_index.push_back(b.cells.size());
+	    b.cells.emplace_back(h, w);
+	  }
+    return is;
+  }
+
+  std::ostream & operator << (std::ostream & os, board const & b)
+  {
+    for (int h=0; h != b.height; ++h)
+      {
+	for (int w=0; w != b.width; ++w)
+	  os << b.at(h,w);
+	os << '\n';
+      }
+    return os;
+  }
+
+  ///////////
+  // other //
+  ///////////
+
+  bool inbounds (location const & l, board const & b)
+  {
+    return (l.first >= 0  && l.first < b.height &&
+	    l.second >= 0 && l.second < b.width);
+  }
+
+  ///////////////
+  // gamestate //
+  ///////////////
+
+  using gamestate = std::map<location, char>;
+
+  template <typename Input>
+  Input & operator >> (Input & is, gamestate & gs)
+  {
+    int tokens;
+    is >> tokens;
+    for (int t=0; t != tokens; ++t)
+      {
+	std::pair<location, char> token;
+	is >> token;
+	gs.insert(token);
+      }
+    return is;
+  }
+
+  std::ostream & operator << (std::ostream & os, gamestate const & gs)
+  {
+    for (auto const & token : gs)
+      os << colour(token.second)
+	 << "(" << token.first.first << ", " << token.first.second << ")"
+	 << colour('\0') << '\n';
+    return os;
+  }
+
+  // Identifies a board together with the colours of its dots, which is all
+  // a codec and the tables built from it depend on
+  std::uint64_t signature (board const & b, gamestate const & gs)
+  {
+    std::string colours;
+    for (auto const & dot : gs)
+      colours.push_back(dot.second);
+    std::sort(colours.begin(), colours.end());
+
+    std::uint64_t h = b.fingerprint();
+    for (char c : colours)
+      h = (h ^ (unsigned char)(c)) * 1099511628211u;
+    return h;
+  }
+
+  bool solved (gamestate const & gs, board const & b)
+  {
+    return std::all_of (gs.begin(), gs.end(),
+			[&] (std::pair<location, char> const & piece)
+			{ return b.at(piece.first) == piece.second; });
+  }
+
+  void print_board (std::ostream & os, board const & b, gamestate const & gs)
+  {
+    for (int h=0; h != b.height; ++h)
+      {
+	for (int w=0; w != b.width; ++w)
+	  {
+	    location l {h,w};
+
+	    if (b.at(l) == 'x')
+	      os << "[=]";
+	    else
+	      {
+		os << colour(b.at(l)) << (b.at(l) == '.' ? ' ' : '<')
+		   << (gs.count(l) == 1 ? colour(gs.at(l)) + "O" : " ")
+		   << colour(b.at(l)) << (b.at(l) == '.' ? ' ' : '>')
+		   << colour('\0');
+	      }
+	  }
+	os << '\n';
+      }
+  }
+
+  /////////
+  // key //
+  /////////
+
+  // A gamestate packed into a fixed-width integer.  The dots are sorted by
+  // cell index, and each one takes dot_bits bits: its cell index, then its
+  // colour index.  A marker bit above the last dot means no key is zero.
+  using key = unsigned __int128;
+
+  class codec
+  {
+    board const * b;
+    std::vector<char> colours;        // colour index -> character
+    int cell_bits, colour_bits;
+
+    static int bits_for (std::size_t values)
+    {
+      int bits = 0;
+      while ((std::size_t(1) << bits) < values)
+	++bits;
+      return bits;
+    }
+
+  public:
+    int dot_bits, n_dots;
+
+    codec (board const & b_, gamestate const & start)
+      : b (&b_), n_dots (start.size())
+    {
+      for (int h=0; h != b -> height; ++h)
+	for (int w=0; w != b -> width; ++w)
+	  if (b -> at(h,w) != 'x' && b -> at(h,w) != '.')
+	    colours.push_back(b -> at(h,w));
+      for (auto const & dot : start)
+	colours.push_back(dot.second);
+      std::sort(colours.begin(), colours.end());
+      colours.erase(std::unique(colours.begin(), colours.end()), colours.end());
+
+      cell_bits = bits_for(b -> cells.size());
+      colour_bits = bits_for(colours.size());
+      dot_bits = cell_bits + colour_bits;
+    }
+
+    // False if the dots do not fit in a key
+    bool fits () const
+    { return n_dots * dot_bits < 128; }
+
+    int colour_index (char c) const
+    { return std::lower_bound(colours.begin(), colours.end(), c) - colours.begin(); }
+
+    char colour_of (int index) const
+    { return colours[index]; }
+
+    int n_colours () const
+    { return colours.size(); }
+
+    // Each dot is (cell << colour_bits) | colour
+    int cell_of_dot (std::uint32_t dot) const
+    { return dot >> colour_bits; }
+
+    int colour_of_dot (std::uint32_t dot) const
+    { return dot & ((1 << colour_bits) - 1); }
+
+    std::uint32_t make_dot (int cell, int colour) const
+    { return (cell << colour_bits) | colour; }
+
+    // The dots must be sorted by cell
+    key pack (std::uint32_t const * dots) const
+    {
+      key k = 1;
+      for (int i = n_dots; i-- > 0; )
+	k = (k << dot_bits) | dots[i];
+      return k;
+    }
+
+    void unpack (key k, std::uint32_t * dots) const
+    {
+      key mask = (key(1) << dot_bits) - 1;
+      for (int i=0; i != n_dots; ++i)
+	{
+	  dots[i] = k & mask;
+	  k >>= dot_bits;
+	}
+    }
+
+    key encode (gamestate const & gs) const
+    {
+      // A map is ordered by location, which is the same as by cell index
+      std::vector<std::uint32_t> dots;
+      for (auto const & dot : gs)
+	dots.push_back(make_dot(b -> index(dot.first), colour_index(dot.second)));
+      return pack(dots.data());
+    }
+
+    gamestate decode (key k) const
+    {
+      std::vector<std::uint32_t> dots (n_dots);
+      unpack(k, dots.data());
+      gamestate gs;
+      for (std::uint32_t dot : dots)
+	gs.emplace(b -> cells[cell_of_dot(dot)], colour_of(colour_of_dot(dot)));
+      return gs;
+    }
+  };
+
+  std::uint64_t key_hash (key k)
+  {
+    std::uint64_t h = std::uint64_t(k) ^ (std::uint64_t(k >> 64) * 0x9e3779b97f4a7c15);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccd;
+    h ^= h >> 33;
+    return h;
+  }
+
+  ///////////////////
+  // visited table //
+  ///////////////////
+
+  // Open-addressing hash table from each visited state to the state it was
+  // reached from, the move that got there and the number of moves from the
+  // start.  Keys are stored as pairs of 64-bit words to keep an entry at 40
+  // bytes; a zero state marks an empty slot.  Linear probing, and the table
+  // doubles when it is three quarters full.
+  class visited_table
+  {
+    struct entry
+    {
+      std::uint64_t state[2];
+      std::uint64_t parent[2];
+      std::uint16_t depth;
+      char move;
+    };
+
+    std::vector<entry> slots;
+    std::size_t count = 0;
+
+    static void split (key k, std::uint64_t * words)
+    {
+      words[0] = std::uint64_t(k);
+      words[1] = std::uint64_t(k >> 64);
+    }
+
+    static key join (std::uint64_t const * words)
+    { return (key(words[1]) << 64) | words[0]; }
+
+    std::size_t slot_of (key k) const
+    {
+      std::size_t mask = slots.size() - 1;
+      std::size_t i = key_hash(k) & mask;
+      while (slots[i].state[0] != 0 || slots[i].state[1] != 0)
+	{
+	  if (join(slots[i].state) == k)
+	    return i;
+	  i = (i + 1) & mask;
+	}
+      return i;
+    }
+
+    void grow ()
+    {
+      std::vector<entry> old (slots.size() * 2, entry {{0, 0}, {0, 0}, 0, '\0'});
+      old.swap(slots);
+      for (entry const & e : old)
+	if (e.state[0] != 0 || e.state[1] != 0)
+	  slots[slot_of(join(e.state))] = e;
+    }
+
+  public:
+    explicit visited_table (std::size_t capacity = 1024)
+    {
+      std::size_t size = 16;
+      while (size < capacity * 4 / 3)
+	size *= 2;
+      slots.assign(size, entry {{0, 0}, {0, 0}, 0, '\0'});
+    }
+
+    // Returns false if the state was already present
+    bool insert (key state, key parent, char move, int depth = 0)
+    {
+      if ((count + 1) * 4 > slots.size() * 3)
+	grow();
+
+      entry & e = slots[slot_of(state)];
+      if (e.state[0] != 0 || e.state[1] != 0)
+	return false;
+
+      split(state, e.state);
+      split(parent, e.parent);
+      e.depth = depth;
+      e.move = move;
+      ++count;
+      return true;
+    }
+
+    // Inserts the state, or lowers its depth if this way is shorter.
+    // Returns false if the state was already known at this depth or less.
+    bool relax (key state, key parent, char move, int depth)
+    {
+      if (insert(state, parent, move, depth))
+	return true;
+
+      entry & e = slots[slot_of(state)];
+      if (e.depth <= depth)
+	return false;
+      split(parent, e.parent);
+      e.depth = depth;
+      e.move = move;
+      return true;
+    }
+
+    // The state must be present
+    int depth (key state) const
+    { return slots[slot_of(state)].depth; }
+
+    bool contains (key state) const
+    {
+      entry const & e = slots[slot_of(state)];
+      return e.state[0] != 0 || e.state[1] != 0;
+    }
+
+    // The state must be present
+    std::pair<key, char> whence (key state) const
+    {
+      entry const & e = slots[slot_of(state)];
+      return {join(e.parent), e.move};
+    }
+
+    // Calls f(state, parent, move, depth) for every state, in no order
+    template <typename F>
+    void for_each (F f) const
+    {
+      for (entry const & e : slots)
+	if (e.state[0] != 0 || e.state[1] != 0)
+	  f(join(e.state), join(e.parent), e.move, e.depth);
+    }
+
+    std::size_t size () const
+    { return count; }
+
+    std::size_t bytes () const
+    { return slots.size() * sizeof(entry); }
+  };
+
+  // A visited table split into shards by the top bits of the hash, each
+  // behind its own lock, so that many threads can insert at once.
+  class sharded_visited_table
+  {
+    std::vector<visited_table> shards;
+    std::vector<std::mutex> locks;
+
+    std::size_t shard_of (key k) const
+    { return (key_hash(k) >> 48) % shards.size(); }
+
+  public:
+    explicit sharded_visited_table (std::size_t n_shards)
+      : shards (n_shards), locks (n_shards)
+    {}
+
+    bool insert (key state, key parent, char move)
+    {
+      std::size_t i = shard_of(state);
+      std::lock_guard<std::mutex> lock (locks[i]);
+      return shards[i].insert(state, parent, move);
+    }
+
+    // Only safe once no thread is inserting
+    std::pair<key, char> whence (key state) const
+    { return shards[shard_of(state)].whence(state); }
+
+    std::size_t size () const
+    {
+      std::size_t total = 0;
+      for (visited_table const & shard : shards)
+	total += shard.size();
+      return total;
+    }
+  };
+
+  /////////////////
+  // slide table //
+  /////////////////
+
+  // Directions are numbered in the order they are tried
+  constexpr char directions[] = "udlr";
+
+  // Per-board tables for working on keys: each square's neighbour in each
+  // direction, or -1 if a wall or the edge stops a dot there, and each
+  // square's goal colour index, or -1.
+  class slide_table
+  {
+    std::vector<int> next;
+    std::vector<int> goal;
+
+  public:
+    slide_table (board const & b, codec const & c)
+    {
+      static location const offsets[] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+      for (location const & l : b.cells)
+	{
+	  for (location const & offset : offsets)
+	    {
+	      location n = l + offset;
+	      next.push_back(inbounds(n, b) ? b.index(n) : -1);
+	    }
+	  goal.push_back(b.at(l) == '.' ? -1 : c.colour_index(b.at(l)));
+	}
+    }
+
+    int step (int cell, int dir) const
+    { return next[cell*4 + dir]; }
+
+    int goal_of (int cell) const
+    { return goal[cell]; }
+  };
+
+  // Moves every dot one square in direction dir, unless a wall stops it or
+  // the dot in front of it is stopped.  The dots are visited front first, so
+  // a single pass decides each one, and nothing is allocated.
+  key slide (key k, codec const & c, slide_table const & t, int dir)
+  {
+    std::uint32_t dots[128];
+    std::uint32_t moved[128];
+    bool stopped[128];
+    int n = c.n_dots;
+    c.unpack(k, dots);
+
+    // Down and right lead to higher cell indices
+    bool forward = dir == 1 || dir == 3;
+    for (int j=0; j != n; ++j)
+      {
+	int i = forward ? n-1-j : j;
+	int cell = c.cell_of_dot(dots[i]);
+	int next = t.step(cell, dir);
+	bool stop = next < 0;
+	if (stop == false)
+	  {
+	    // Any dot in the way has already been decided
+	    std::uint32_t * ahead = std::lower_bound(dots, dots + n, c.make_dot(next, 0));
+	    stop = ahead != dots + n && c.cell_of_dot(*ahead) == next && stopped[ahead - dots];
+	  }
+	stopped[i] = stop;
+	moved[i] = stop ? dots[i] : c.make_dot(next, c.colour_of_dot(dots[i]));
+      }
+
+    // Sliding sideways keeps the dots in row-major order, but sliding up or
+    // down can reorder them
+    if (dir < 2)
+      for (int i=1; i != n; ++i)
+	for (int j=i; j != 0 && moved[j-1] > moved[j]; --j)
+	  std::swap(moved[j-1], moved[j]);
+
+    return c.pack(moved);
+  }
+
+  bool solved (key k, codec const & c, slide_table const & t)
+  {
+    std::uint32_t dots[128];
+    c.unpack(k, dots);
+    return std::all_of(dots, dots + c.n_dots, [&] (std::uint32_t dot)
+		       { return t.goal_of(c.cell_of_dot(dot)) == c.colour_of_dot(dot); });
+  }
+
+  ///////////////
+  // heuristic //
+  ///////////////
+
+  // For each colour, the number of moves from every square to the nearest
+  // goal square of that colour, ignoring the other dots.  A move takes each
+  // dot at most one square, so the largest of these over all dots never
+  // overestimates the moves left, and changes by at most one per move.
+  class goal_distance
+  {
+    int n_cells;
+    std::vector<std::uint16_t> distance;   // distance[colour*n_cells + cell]
+
+  public:
+    static constexpr std::uint16_t unreachable = 0xffff;
+
+    goal_distance (board const & b, codec const & c, slide_table const & t)
+      : n_cells (b.cells.size()), distance (c.n_colours() * n_cells, unreachable)
+    {
+      std::vector<int> queue;
+      for (int colour=0; colour != c.n_colours(); ++colour)
+	{
+	  std::uint16_t * d = &distance[colour * n_cells];
+	  queue.clear();
+	  for (int cell=0; cell != n_cells; ++cell)
+	    if (t.goal_of(cell) == colour)
+	      {
+		d[cell] = 0;
+		queue.push_back(cell);
+	      }
+
+	  // Neighbours are symmetric, so searching outwards from the goals
+	  // gives the distance to them
+	  for (std::size_t q=0; q != queue.size(); ++q)
+	    for (int dir=0; dir != 4; ++dir)
+	      {
+		int next = t.step(queue[q], dir);
+		if (next >= 0 && d[next] == unreachable)
+		  {
+		    d[next] = d[queue[q]] + 1;
+		    queue.push_back(next);
+		  }
+	      }
+	}
+    }
+
+    // A lower bound on the moves needed to solve k, or unreachable
+    int operator () (key k, codec const & c) const
+    {
+      std::uint32_t dots[128];
+      c.unpack(k, dots);
+      int bound = 0;
+      for (int i=0; i != c.n_dots; ++i)
+	bound = std::max<int>(bound, distance[c.colour_of_dot(dots[i]) * n_cells + c.cell_of_dot(dots[i])]);
+      return bound;
+    }
+  };
+
+  ////////////
+  // search //
+  ////////////
+
+  struct search_result
+  {
+    bool found = false;
+    bool gave_up = false;        // stopped at the node limit, neither found nor ruled out
+    std::string moves;
+    std::size_t visited = 0;
+    std::size_t expanded = 0;
+
+    // Only counted when built with AD_METRICS
+    ad::counter duplicates;      // moves to a state already seen
+    ad::counter peak_frontier;   // the most states waiting to be expanded
+    ad::counter peak_visited;    // the most states held at once
+  };
+
+  void write_metrics (ad::json_writer & j, search_result const & r)
+  {
+    j.begin("move")
+      .field("found", r.found)
+      .field("moves", std::uint64_t(r.moves.size()))
+      .field("expanded", std::uint64_t(r.expanded))
+      .field("visited", std::uint64_t(r.visited))
+      .field("duplicates", r.duplicates)
+      .field("peak_frontier", r.peak_frontier)
+      .field("peak_visited", r.peak_visited)
+      .end();
+  }
+
+  // Follows the parent links back from a state to the start
+  template <typename Table>
+  std::string path_to (Table const & whence_map, key s)
+  {
+    std::string moves;
+    while (whence_map.whence(s).second != '\0')
+      {
+	moves.push_back(whence_map.whence(s).second);
+	s = whence_map.whence(s).first;
+      }
+    std::reverse(moves.begin(), moves.end());
+    return moves;
+  }
+
+  search_result solve_bfs (key start, codec const & c, slide_table const & t)
+  {
+    search_result r;
+    std::queue<key> node_queue;
+    node_queue.push(start);
+    visited_table whence_map;
+    whence_map.insert(start, start, '\0');
+
+    while (node_queue.empty() == false && solved(node_queue.front(), c, t) == false)
+      {
+	++r.expanded;
+	for (int d=0; d != 4; ++d)
+	  {
+	    key next = slide (node_queue.front(), c, t, d);
+	    if (whence_map.insert(next, node_queue.front(), directions[d]))
+	      node_queue.push(next);
+	    else
+	      ++r.duplicates;
+	  }
+	r.peak_frontier.at_least(node_queue.size());
+	node_queue.pop();
+      }
+
+    r.visited = whence_map.size();
+    r.peak_visited.at_least(r.visited);
+    if (node_queue.empty() == false)
+      {
+	r.found = true;
+	r.moves = path_to(whence_map, node_queue.front());
+      }
+    return r;
+  }
+
+  // A* with the goal distance bound.  Moves cost one and the bound is
+  // consistent, so open states are kept in buckets by f = g + h; within a
+  // bucket the most recently added state is taken first, which favours
+  // deeper states.  A state reached again by a shorter path is reopened.
+  // With a node_limit, it gives up rather than expand more states than
+  // that, which bounds both its time and the states it holds.
+  search_result solve_astar (key start, codec const & c, slide_table const & t,
+			     goal_distance const & h, std::size_t node_limit = 0)
+  {
+    search_result r;
+    visited_table whence_map;
+    std::vector<std::vector<key>> buckets;
+    std::size_t open = 0;
+
+    auto push = [&] (key k, int f)
+      {
+	if (buckets.size() <= std::size_t(f))
+	  buckets.resize(f + 1);
+	buckets[f].push_back(k);
+	r.peak_frontier.at_least(++open);
+      };
+
+    int h0 = h(start, c);
+    if (h0 == goal_distance::unreachable)
+      return r;
+    whence_map.insert(start, start, '\0', 0);
+    push(start, h0);
+
+    for (std::size_t f = h0; f < buckets.size(); ++f)
+      while (buckets[f].empty() == false)
+	{
+	  key k = buckets[f].back();
+	  buckets[f].pop_back();
+	  --open;
+
+	  // Skip states that have since been reached by a shorter path
+	  int g = whence_map.depth(k);
+	  if (g + h(k, c) != int(f))
+	    continue;
+
+	  if (solved(k, c, t))
+	    {
+	      r.found = true;
+	      r.moves = path_to(whence_map, k);
+	      r.visited = whence_map.size();
+	      r.peak_visited.at_least(r.visited);
+	      return r;
+	    }
+
+	  if (r.expanded == node_limit && node_limit != 0)
+	    {
+	      r.gave_up = true;
+	      r.visited = whence_map.size();
+	      r.peak_visited.at_least(r.visited);
+	      return r;
+	    }
+
+	  ++r.expanded;
+	  for (int d=0; d != 4; ++d)
+	    {
+	      key next = slide (k, c, t, d);
+	      int hn = h(next, c);
+	      if (hn == goal_distance::unreachable)
+		continue;
+	      if (whence_map.relax(next, k, directions[d], g + 1))
+		push(next, g + 1 + hn);
+	      else
+		++r.duplicates;
+	    }
+	}
+
+    r.visited = whence_map.size();
+    r.peak_visited.at_least(r.visited);
+    return r;
+  }
+
+  // Breadth first search one level at a time.  Each level's states are
+  // split into chunks which the pool expands in parallel, inserting into a
+  // shared sharded table; the new states of each chunk become part of the
+  // next level, in chunk order.  Every state in a level is the same number
+  // of moves from the start, so the first solved state found is as close as
+  // any, although which one is found can vary from run to run.
+  search_result solve_parallel_bfs (key start, codec const & c, slide_table const & t,
+				    ad::thread_pool & pool)
+  {
+    search_result r;
+    sharded_visited_table whence_map (64 * pool.size());
+    whence_map.insert(start, start, '\0');
+
+    if (solved(start, c, t))
+      {
+	r.found = true;
+	r.visited = 1;
+	return r;
+      }
+
+    std::vector<key> level {start};
+    std::vector<std::vector<key>> next_levels;
+    std::vector<ad::counter> duplicates;
+    std::atomic<std::size_t> expanded {0};
+    std::atomic<bool> found {false};
+    key goal = 0;
+    std::mutex goal_mutex;
+
+    while (level.empty() == false && found == false)
+      {
+	std::size_t n_chunks = std::min<std::size_t>(level.size(), 16 * pool.size());
+	next_levels.assign(n_chunks, {});
+	duplicates.assign(n_chunks, {});
+	r.peak_frontier.at_least(level.size());
+
+	pool.parallel_for(n_chunks, [&] (std::size_t chunk)
+	  {
+	    std::size_t first = level.size() * chunk / n_chunks;
+	    std::size_t last = level.size() * (chunk + 1) / n_chunks;
+	    std::vector<key> & next_level = next_levels[chunk];
+	    std::size_t i = first;
+	    for ( ; i != last && found == false; ++i)
+	      for (int d=0; d != 4; ++d)
+		{
+		  key next = slide (level[i], c, t, d);
+		  if (whence_map.insert(next, level[i], directions[d]))
+		    {
+		      if (solved(next, c, t))
+			{
+			  std::lock_guard<std::mutex> lock (goal_mutex);
+			  if (found == false)
+			    goal = next;
+			  found = true;
+			}
+		      next_level.push_back(next);
+		    }
+		  else
+		    ++duplicates[chunk];
+		}
+	    expanded += i - first;
+	  });
+
+	for (ad::counter const & n : duplicates)
+	  r.duplicates += n.value();
+	level.clear();
+	for (std::vector<key> const & next_level : next_levels)
+	  level.insert(level.end(), next_level.begin(), next_level.end());
+      }
+
+    r.expanded = expanded;
+    r.visited = whence_map.size();
+    r.peak_visited.at_least(r.visited);
+    if (found)
+      {
+	r.found = true;
+	r.moves = path_to(whence_map, goal);
+      }
+    return r;
+  }
+}
+
+#endif
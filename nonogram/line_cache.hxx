@@ -0,0 +1,157 @@
+#ifndef AD_LINE_CACHE_HXX
+#define AD_LINE_CACHE_HXX
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace ad
+{
+  // A bounded cache of line solutions, keyed by the line length, the hints
+  // and the known cells.  Many lines are solved more than once with the same
+  // key: fully open lines with common hints, empty rows, lines repeated
+  // across puzzles in a batch.  The cache can be shared by any number of
+  // nonograms, on any number of threads; it is split into shards, each with
+  // its own lock and its own least-recently-used list.
+  class line_cache
+  {
+  public:
+    using word = std::uint64_t;
+
+  private:
+    struct entry
+    {
+      std::vector<word> key;
+      std::vector<word> result;   // new black words, then new white words
+      bool consistent;
+    };
+
+    struct key_hash
+    {
+      std::size_t operator () (std::vector<word> const * key) const
+      { return hash (*key); }
+    };
+
+    struct key_equal
+    {
+      bool operator () (std::vector<word> const * a, std::vector<word> const * b) const
+      { return *a == *b; }
+    };
+
+    struct shard
+    {
+      std::mutex mutex;
+      std::list<entry> entries;   // most recently used first
+      std::unordered_map<std::vector<word> const *, std::list<entry>::iterator, key_hash, key_equal> index;
+    };
+
+    std::size_t shard_capacity;
+    std::vector<shard> shards;
+
+    std::atomic<std::uint64_t> n_hits {0};
+    std::atomic<std::uint64_t> n_misses {0};
+    std::atomic<std::uint64_t> n_evictions {0};
+
+    static std::size_t hash (std::vector<word> const & key)
+    {
+      std::uint64_t h = 0x9e3779b97f4a7c15;
+      for (word w : key)
+      {
+        h ^= w + 0x9e3779b97f4a7c15 + (h << 6) + (h >> 2);
+        h *= 0xff51afd7ed558ccd;
+      }
+      return h ^ (h >> 32);
+    }
+
+    shard & shard_for (std::vector<word> const & key)
+    { return shards[(hash (key) >> 16) % shards.size()]; }
+
+    // No more shards than lines, so that each holds at least one
+    static std::size_t shard_count (std::size_t capacity, unsigned n_shards)
+    { return std::max<std::size_t> (1, std::min<std::size_t> (n_shards, capacity)); }
+
+  public:
+    // Holds at most capacity lines in total; with 0 it holds none
+    explicit line_cache (std::size_t capacity, unsigned n_shards = 16)
+      : shard_capacity (capacity / shard_count (capacity, n_shards)),
+        shards (shard_count (capacity, n_shards))
+    {}
+
+    // Packs a line into a key
+    static void make_key (std::vector<word> & key, unsigned length, std::vector<unsigned> const & hints,
+                          word const * black, word const * white, unsigned n_words)
+    {
+      key.clear();
+      key.push_back ((word(length) << 32) | hints.size());
+      for (unsigned i=0; i < hints.size(); i += 2)
+        key.push_back ((word(hints[i]) << 32) | (i+1 < hints.size() ? hints[i+1] : 0));
+      key.insert (key.end(), black, black + n_words);
+      key.insert (key.end(), white, white + n_words);
+    }
+
+    // On a hit, copies the stored solution out and returns true
+    bool find (std::vector<word> const & key, bool & consistent,
+               word * new_black, word * new_white, unsigned n_words)
+    {
+      shard & s = shard_for (key);
+      std::lock_guard<std::mutex> lock (s.mutex);
+
+      auto iter = s.index.find (&key);
+      if (iter == s.index.end())
+      {
+        ++ n_misses;
+        return false;
+      }
+      ++ n_hits;
+
+      s.entries.splice (s.entries.begin(), s.entries, iter -> second);
+      entry const & e = *iter -> second;
+      consistent = e.consistent;
+      std::copy (e.result.begin(), e.result.begin() + n_words, new_black);
+      std::copy (e.result.begin() + n_words, e.result.end(), new_white);
+      return true;
+    }
+
+    void insert (std::vector<word> const & key, bool consistent,
+                 word const * new_black, word const * new_white, unsigned n_words)
+    {
+      if (shard_capacity == 0)
+        return;
+
+      shard & s = shard_for (key);
+      std::lock_guard<std::mutex> lock (s.mutex);
+
+      // Another thread may have solved the same line in the meantime
+      if (s.index.count (&key) != 0)
+        return;
+
+      if (s.entries.size() >= shard_capacity)
+      {
+        s.index.erase (&s.entries.back().key);
+        s.entries.pop_back();
+        ++ n_evictions;
+      }
+
+      entry e {key, std::vector<word> (new_black, new_black + n_words), consistent};
+      e.result.insert (e.result.end(), new_white, new_white + n_words);
+      s.entries.push_front (std::move (e));
+      s.index.emplace (&s.entries.front().key, s.entries.begin());
+    }
+
+    std::uint64_t hits () const      { return n_hits; }
+    std::uint64_t misses () const    { return n_misses; }
+    std::uint64_t evictions () const { return n_evictions; }
+
+    double hit_rate () const
+    {
+      std::uint64_t lookups = hits() + misses();
+      return lookups == 0 ? 0 : double (hits()) / lookups;
+    }
+  };
+}
+
+#endif
@@ -1,86 +1,558 @@
 #ifndef AD_NONOGRAM_HXX
 #define AD_NONOGRAM_HXX
 
+#include <algorithm>
+#include <array>
+#include <cstdint>
 #include <iostream>
+#include <memory>
+#include <queue>
 #include <vector>
 
+#include "../common/metrics.hxx"
+#include "../common/thread_pool.hxx"
+#include "line_cache.hxx"
+
 namespace ad
 {
   class nonogram
   {
+    using word = std::uint64_t;
+    static constexpr uint word_bits = 64;
+
     uint W, H;
     std::vector<std::vector<uint>> cols;
     std::vector<std::vector<uint>> rows;
 
     enum cell {open, black, white};
-    std::vector< std::vector<cell> > grid;
-
-    class row_iterator;
 
-    std::vector<cell> work_row (std::vector<cell> const & known, std::vector<uint> const & hints);
+    // The grid is kept as two bit planes, known-black and known-white.  Each
+    // plane is stored both row-major and column-major, so every line is a
+    // contiguous run of words whichever way it runs.
+    uint row_words, col_words;
+    std::vector<word> row_black, row_white;   // H lines of row_words words
+    std::vector<word> col_black, col_white;   // W lines of col_words words
+
+    static uint words (uint length)
+    { return (length + word_bits - 1) / word_bits; }
+
+    static bool test (word const * bits, uint i)
+    { return (bits[i / word_bits] >> (i % word_bits)) & 1; }
+
+    static void set_bit (word * bits, uint i)
+    { bits[i / word_bits] |= word(1) << (i % word_bits); }
+
+    cell at (uint h, uint w) const;
+    void set (uint h, uint w, cell c);
+
+    class line_solver;
+    template <uint MaxLength> class word_line_solver;
+
+    // Propagation state
+    std::vector<uint> priority;
+    std::priority_queue<std::pair<uint,uint>> queue;
+    std::unique_ptr<thread_pool> pool;
+    line_cache * cache = nullptr;
+    uint line_solves = 0;
+
+    bool solve_line (uint line, word * new_black, word * new_white);
+    void apply (uint line, word const * new_black, word const * new_white);
+    void touch (uint line);
+    bool propagate ();
+    bool propagate_serial ();
+    bool propagate_parallel ();
+    void clear_pending ();
+
+    // Search state: a copy of the bit planes, saved before a guess is made
+    // and restored when it is taken back.
+    struct state
+    {
+      std::vector<word> row_black, row_white, col_black, col_white;
+    };
+    state snapshot () const;
+    void restore (state const & s);
+    uint known_cells () const;
+    void assume (uint h, uint w, cell c);
+
+    uint solutions = 0;
+    state first_solution;
+    uint probes = 0, branches = 0;
+
+    // Only counted when built with AD_METRICS.  A pass is one run of
+    // propagation until no line has anything left to fix.
+    counter cells_fixed;
+    histogram fixed_per_pass;   // by the number of bits in the count
+    timer propagate_time, probe_time, search_time;
+
+    bool probe (uint & branch_h, uint & branch_w);
+    void search ();
+
+    bool work_row (word const * black, word const * white, uint length, std::vector<uint> const & hints,
+                   word * new_black, word * new_white);
+    static uint initial_priority (std::vector<uint> const & hints, uint length);
 
   public:
     nonogram ()
     {}
 
-    void solve ();
+    // Solve lines on this many threads; 1 (the default) is serial.
+    void set_threads (uint threads);
+
+    // Look lines up in (and add them to) a cache, which may be shared with
+    // other nonograms.  Pass nullptr to stop using it.
+    void use_cache (line_cache * c)
+    { cache = c; }
+
+    enum result {solved, multiple, none};
 
-    friend std::istream & operator >> (std::istream & is, nonogram & ng);
+    // Fills in the grid.  If the puzzle has more than one solution, the grid
+    // holds one of them; if it has none, the grid is left as it was after
+    // propagating the hints.
+    result solve ();
+
+    // The work done by the last solve()
+    uint line_solve_count () const { return line_solves; }
+    uint probe_count () const      { return probes; }
+    uint branch_count () const     { return branches; }
+
+    // Writes the work done and the time spent in each phase by the last
+    // solve(): propagating the hints, then searching, which includes probing
+    void write_metrics (json_writer & j) const;
+
+    // Reads from a std::istream or an ad::scanner
+    template <typename Input>
+    friend Input & operator >> (Input & is, nonogram & ng);
     friend std::ostream & operator << (std::ostream & os, nonogram const & ng);
   };
 
-  void nonogram::solve ()
+  nonogram::cell nonogram::at (uint h, uint w) const
   {
-    uint passes = 0;
+    if (test (&row_black[h*row_words], w)) return black;
+    if (test (&row_white[h*row_words], w)) return white;
+    return open;
+  }
 
-    bool solved;
-    do
+  void nonogram::set (uint h, uint w, cell c)
+  {
+    if (c == black)
     {
-      solved = true;
+      set_bit (&row_black[h*row_words], w);
+      set_bit (&col_black[w*col_words], h);
+    }
+    else if (c == white)
+    {
+      set_bit (&row_white[h*row_words], w);
+      set_bit (&col_white[w*col_words], h);
+    }
+  }
 
-      // Work rows
-      for (uint h=0; h < H; ++h)
+  // Lines are numbered rows first, then columns.  Each line carries a
+  // priority: the number of its cells fixed since it was last solved, or for
+  // a line not yet solved, the number of cells the hints alone will fix.  Only
+  // lines with a non-zero priority are in the queue, so a line whose crossing
+  // lines have not changed is never solved twice.
+  uint nonogram::initial_priority (std::vector<uint> const & hints, uint length)
+  {
+    if (hints.empty())
+      return length;
+
+    uint min_length = hints.size() - 1;
+    for (uint h : hints)
+      min_length += h;
+    uint slack = length - min_length;
+
+    // Overlap of each block's left-most and right-most placement
+    uint overlap = 0;
+    for (uint h : hints)
+      if (h > slack)
+        overlap += h - slack;
+    return overlap + 1;
+  }
+
+  // Lines are indexed rows first, then columns
+  bool nonogram::solve_line (uint line, word * new_black, word * new_white)
+  {
+    bool is_row = line < H;
+    uint index = is_row ? line : line - H;
+    uint n_words = is_row ? row_words : col_words;
+    std::vector<word> const & black = is_row ? row_black : col_black;
+    std::vector<word> const & white = is_row ? row_white : col_white;
+
+    return work_row (&black[index*n_words], &white[index*n_words], is_row ? W : H,
+                     is_row ? rows[index] : cols[index], new_black, new_white);
+  }
+
+  // Records every cell newly fixed by a solved line, and touches the line
+  // crossing it.
+  void nonogram::apply (uint line, word const * new_black, word const * new_white)
+  {
+    bool is_row = line < H;
+    uint index = is_row ? line : line - H;
+    uint n_words = is_row ? row_words : col_words;
+    word const * black = is_row ? &row_black[index*n_words] : &col_black[index*n_words];
+    word const * white = is_row ? &row_white[index*n_words] : &col_white[index*n_words];
+
+    for (uint k=0; k < n_words; ++k)
+    {
+      word fixed_black = new_black[k] & ~black[k];
+      word fixed_white = new_white[k] & ~white[k];
+      cells_fixed += __builtin_popcountll (fixed_black | fixed_white);
+      for (word fixed = fixed_black | fixed_white; fixed != 0; fixed &= fixed - 1)
       {
-        std::vector<cell> new_row = work_row (grid[h], rows[h]);
+        uint b = __builtin_ctzll (fixed);
+        uint i = k*word_bits + b;
+        cell c = (fixed_black >> b) & 1 ? nonogram::black : nonogram::white;
+        if (is_row)
+        {
+          set (index, i, c);
+          touch (H+i);
+        }
+        else
+        {
+          set (i, index, c);
+          touch (i);
+        }
+      }
+    }
+  }
 
-        for (uint i=0; i<W; ++i)
-          if (grid[h][i] == open)
-          {
-            grid[h][i] = new_row[i];
-            solved = false;
-          }
+  void nonogram::touch (uint line)
+  {
+    ++ priority[line];
+    if (pool == nullptr)
+      queue.emplace (priority[line], line);
+  }
+
+  bool nonogram::propagate ()
+  {
+    std::uint64_t before = cells_fixed.value();
+    bool consistent = pool == nullptr ? propagate_serial() : propagate_parallel();
+    fixed_per_pass.add_log2 (cells_fixed.value() - before);
+    return consistent;
+  }
+
+  // Forgets every pending line, after a contradiction
+  void nonogram::clear_pending ()
+  {
+    std::fill (priority.begin(), priority.end(), 0);
+    queue = {};
+  }
+
+  // Solves the line with the highest priority until none are left.  Returns
+  // false if some line has no arrangement consistent with the grid.
+  bool nonogram::propagate_serial ()
+  {
+    std::vector<word> new_black (std::max (row_words, col_words));
+    std::vector<word> new_white (new_black.size());
+    while (queue.empty() == false)
+    {
+      auto [p, line] = queue.top();
+      queue.pop();
+
+      // Skip entries superseded by a later push
+      if (p != priority[line])
+        continue;
+      priority[line] = 0;
+      ++ line_solves;
+
+      if (solve_line (line, new_black.data(), new_white.data()) == false)
+      {
+        clear_pending();
+        return false;
+      }
+      apply (line, new_black.data(), new_white.data());
+    }
+    return true;
+  }
+
+  // Alternates between solving every pending row and every pending column.
+  // Lines within a phase are independent: each is solved against the grid as
+  // it stood at the start of the phase, and the results are applied in order
+  // once the phase is over.
+  bool nonogram::propagate_parallel ()
+  {
+    std::vector<uint> pending;
+    std::vector<word> new_black, new_white;
+    std::vector<char> consistent;
+
+    for (bool is_row = true; ; is_row = !is_row)
+    {
+      pending.clear();
+      uint first = is_row ? 0 : H;
+      uint last  = is_row ? H : H+W;
+      for (uint line = first; line != last; ++line)
+        if (priority[line] != 0)
+          pending.push_back (line);
+
+      if (pending.empty())
+      {
+        // Stop once neither rows nor columns have anything left to do
+        bool idle = true;
+        for (uint p : priority)
+          idle = idle && p == 0;
+        if (idle)
+          break;
+        continue;
       }
 
-      // Work columns
-      for (uint w=0; w < W; ++w)
+      uint n_words = is_row ? row_words : col_words;
+      new_black.resize (pending.size() * n_words);
+      new_white.resize (pending.size() * n_words);
+      consistent.resize (pending.size());
+
+      pool -> parallel_for (pending.size(), [&] (std::size_t t)
+        {
+          consistent[t] = solve_line (pending[t], &new_black[t*n_words], &new_white[t*n_words]);
+        });
+
+      line_solves += pending.size();
+      if (std::find (consistent.begin(), consistent.end(), false) != consistent.end())
       {
-        std::vector<cell> col (H);
-        for (uint i=0; i<H; ++i)
-          col[i] = grid[i][w];
+        clear_pending();
+        return false;
+      }
+      for (uint t=0; t < pending.size(); ++t)
+      {
+        priority[pending[t]] = 0;
+        apply (pending[t], &new_black[t*n_words], &new_white[t*n_words]);
+      }
+    }
+    return true;
+  }
+
+  void nonogram::set_threads (uint threads)
+  {
+    if (threads > 1)
+      pool = std::make_unique<thread_pool> (threads);
+    else
+      pool.reset();
+  }
+
+  nonogram::state nonogram::snapshot () const
+  {
+    return state {row_black, row_white, col_black, col_white};
+  }
+
+  void nonogram::restore (state const & s)
+  {
+    row_black = s.row_black;
+    row_white = s.row_white;
+    col_black = s.col_black;
+    col_white = s.col_white;
+  }
+
+  uint nonogram::known_cells () const
+  {
+    uint known = 0;
+    for (uint k=0; k < row_black.size(); ++k)
+      known += __builtin_popcountll (row_black[k] | row_white[k]);
+    return known;
+  }
+
+  // Sets a cell and queues both lines through it
+  void nonogram::assume (uint h, uint w, cell c)
+  {
+    set (h, w, c);
+    touch (h);
+    touch (H+w);
+  }
+
+  // Tries both colours in every open cell, propagating each.  A colour that
+  // leads to a contradiction fixes the cell to the other one, and cells which
+  // come out the same either way are fixed too.  Repeats until a full sweep
+  // learns nothing, and returns false if some cell can be neither colour.
+  //
+  // Otherwise branch_h and branch_w are set to the open cell whose weaker
+  // probe fixed the most cells, which makes a good cell to branch on, or to
+  // H if the grid is complete.
+  bool nonogram::probe (uint & branch_h, uint & branch_w)
+  {
+    timed t (probe_time);
+    state root = snapshot();
+    uint root_known = known_cells();
+
+    bool changed = true;
+    while (changed)
+    {
+      changed = false;
+      uint best = 0;
+      branch_h = H;
+      branch_w = 0;
+
+      for (uint h=0; h < H; ++h)
+        for (uint w=0; w < W; ++w)
+        {
+          if (at (h, w) != open)
+            continue;
+          ++ probes;
 
-        std::vector<cell> new_col = work_row (col, cols[w]);
+          assume (h, w, black);
+          bool black_ok = propagate();
+          uint black_fixed = known_cells() - root_known;
+          state after_black = black_ok ? snapshot() : state {};
+          restore (root);
 
-        for (uint i=0; i<H; ++i)
-          if (grid[i][w] == open)
+          assume (h, w, white);
+          bool white_ok = propagate();
+          uint white_fixed = known_cells() - root_known;
+
+          if (!black_ok && !white_ok)
+            return false;
+
+          if (black_ok && white_ok)
           {
-            grid[i][w] = new_col[i];
-            solved = false;
+            // Keep whatever both colours agree on
+            bool agreed = false;
+            for (uint k=0; k < row_black.size(); ++k)
+            {
+              row_black[k] &= after_black.row_black[k];
+              row_white[k] &= after_black.row_white[k];
+              agreed = agreed || row_black[k] != root.row_black[k] || row_white[k] != root.row_white[k];
+            }
+            if (agreed == false)
+            {
+              restore (root);
+              uint score = std::min (black_fixed, white_fixed);
+              if (branch_h == H || score > best)
+              {
+                best = score;
+                branch_h = h;
+                branch_w = w;
+              }
+              continue;
+            }
+
+            // Rebuild the column planes from the agreed rows, then propagate
+            // from the new cells
+            state agreed_rows = snapshot();
+            restore (root);
+            for (uint r=0; r < H; ++r)
+              for (uint c=0; c < W; ++c)
+                if (at (r, c) == open)
+                {
+                  if (test (&agreed_rows.row_black[r*row_words], c))
+                    assume (r, c, black);
+                  else if (test (&agreed_rows.row_white[r*row_words], c))
+                    assume (r, c, white);
+                }
+            if (propagate() == false)
+              return false;
           }
+          else if (black_ok)
+            restore (after_black);
+
+          // Otherwise the grid already holds the white probe
+          root = snapshot();
+          root_known = known_cells();
+          changed = true;
+        }
+    }
+    return true;
+  }
+
+  // Counts solutions below the current grid, stopping at two.  The first one
+  // found is kept in first_solution.
+  void nonogram::search ()
+  {
+    uint h, w;
+    if (propagate() == false || probe (h, w) == false)
+      return;
+
+    if (h == H)
+    {
+      if (++solutions == 1)
+        first_solution = snapshot();
+      return;
+    }
+
+    ++ branches;
+    state saved = snapshot();
+    for (cell c : {black, white})
+    {
+      restore (saved);
+      assume (h, w, c);
+      search();
+      if (solutions > 1)
+        return;
+    }
+  }
+
+  nonogram::result nonogram::solve ()
+  {
+    line_solves = 0;
+    probes = 0;
+    branches = 0;
+    solutions = 0;
+    cells_fixed = {};
+    fixed_per_pass = {};
+    propagate_time = probe_time = search_time = {};
+
+    priority.resize (H + W);
+    queue = {};
+    for (uint line=0; line < H+W; ++line)
+    {
+      priority[line] = line < H ? initial_priority (rows[line], W)
+                                : initial_priority (cols[line-H], H);
+      if (pool == nullptr)
+        queue.emplace (priority[line], line);
+    }
+
+    // Propagating the hints alone solves most puzzles; search only if that
+    // leaves cells open
+    result r = none;
+    bool consistent;
+    {
+      timed t (propagate_time);
+      consistent = propagate();
+    }
+    if (consistent)
+    {
+      state root = snapshot();
+      {
+        timed t (search_time);
+        search();
+      }
+      if (solutions == 0)
+        restore (root);
+      else
+      {
+        restore (first_solution);
+        r = solutions == 1 ? solved : multiple;
       }
-      ++ passes;
     }
-    while (solved == false);
-    std::cerr << passes << " passes\n";
+
+    return r;
   }
 
-  std::istream & operator >> (std::istream & is, nonogram & ng)
+  void nonogram::write_metrics (json_writer & j) const
+  {
+    j.begin ("nonogram")
+      .field ("width", std::uint64_t (W))
+      .field ("height", std::uint64_t (H))
+      .field ("line_solves", std::uint64_t (line_solves))
+      .field ("probes", std::uint64_t (probes))
+      .field ("branches", std::uint64_t (branches))
+      .field ("cells_fixed", cells_fixed)
+      .field ("fixed_per_pass_log2", fixed_per_pass)
+      .begin ("seconds")
+        .field ("propagate", propagate_time)
+        .field ("search", search_time)
+        .field ("probe", probe_time)
+      .end()
+      .end();
+  }
+
+  template <typename Input>
+  Input & operator >> (Input & is, nonogram & ng)
   {
     // Read dimensions and resize grid
     is >> ng.W >> ng.H;
-    ng.grid.resize(ng.H);
-    for (auto & row : ng.grid)
-      row.resize(ng.W);
-
+    ng.row_words = nonogram::words (ng.W);
+    ng.col_words = nonogram::words (ng.H);
+    ng.row_black.assign (ng.H * ng.row_words, 0);
+    ng.row_white.assign (ng.H * ng.row_words, 0);
+    ng.col_black.assign (ng.W * ng.col_words, 0);
+    ng.col_white.assign (ng.W * ng.col_words, 0);
 
     // Read hints; each group of hints is terminated by a 0
 
@@ -128,7 +600,7 @@ namespace ad
       for (uint w=0; w < ng.W; ++w)
       {
         os << (w%5==0 ? '|' : ' ');
-        switch (ng.grid[h][w])
+        switch (ng.at (h, w))
         {
         case nonogram::open:
           os << "  ";
@@ -150,174 +622,318 @@ namespace ad
     return os;
   }
 
-  class nonogram::row_iterator
+  // Decides every cell of a line that is forced by the hints and the cells
+  // already known, without enumerating arrangements.
+  //
+  // fwd[j][i] is true if the first j blocks fit in cells [0, i) with every
+  // other cell of that prefix white; bwd[j][i] is true if blocks j.. fit in
+  // cells [i, length) likewise.  A cell may be white if some split j places
+  // blocks 0..j-1 to its left and j.. to its right; it may be black if some
+  // block j can cover it with both sides still fitting.  This is O(length *
+  // blocks) per line, and the scratch buffers are reused between calls.
+  class nonogram::line_solver
   {
-    uint length;
-    std::vector<uint> hints;
-    std::vector<uint> starts;
-    std::vector<uint> max_starts;
-    std::vector<cell> row;
-    bool row_ready = false;
-    bool end = false;
-
-    void init ()
+    uint length = 0;
+    uint blocks = 0;
+    word const * black = nullptr;
+    std::vector<char> fwd;
+    std::vector<char> bwd;
+    std::vector<uint> whites;   // whites[i] = number of known white cells in [0, i)
+    std::vector<int>  paint;    // difference array of cells that may be black
+    std::vector<word> may_white;
+    std::vector<word> may_black;
+
+    char & f (uint j, uint i) { return fwd[j*(length+1) + i]; }
+    char & b (uint j, uint i) { return bwd[j*(length+2) + i]; }
+
+    bool is_black (uint i) const
+    { return test (black, i); }
+
+    // True if cells [from, to) contain no known white cell
+    bool no_white (uint from, uint to) const
+    { return whites[to] == whites[from]; }
+
+  public:
+    // Writes the cells known after solving to new_black and new_white.
+    // Returns false if no arrangement of the hints is consistent with the
+    // known cells.
+    bool solve (word const * known_black, word const * known_white, uint length_,
+                std::vector<uint> const & hints, word * new_black, word * new_white)
     {
-      row.resize (length);
+      length = length_;
+      blocks = hints.size();
+      black = known_black;
+      uint n_words = words (length);
+
+      fwd.assign ((blocks+1) * (length+1), false);
+      bwd.assign ((blocks+1) * (length+2), false);
+      whites.resize (length+1);
+      paint.assign (length+1, 0);
+      may_white.assign (n_words, 0);
+      may_black.assign (n_words, 0);
+
+      whites[0] = 0;
+      for (uint i=0; i<length; ++i)
+        whites[i+1] = whites[i] + test (known_white, i);
+
+      // Forward pass
+      f(0,0) = true;
+      for (uint i=1; i<=length; ++i)
+        f(0,i) = f(0,i-1) && !is_black (i-1);
+      for (uint j=1; j<=blocks; ++j)
+      {
+        uint len = hints[j-1];
+        for (uint i=1; i<=length; ++i)
+        {
+          // Cell i-1 is white ...
+          bool ok = !is_black (i-1) && f(j,i-1);
+          // ... or block j-1 ends at cell i-1
+          if (!ok && i >= len && no_white (i-len, i))
+          {
+            uint s = i - len;
+            if (j == 1)
+              ok = f(0,s);
+            else
+              ok = s >= 1 && !is_black (s-1) && f(j-1,s-1);
+          }
+          f(j,i) = ok;
+        }
+      }
+
+      if (f(blocks,length) == false)
+        return false;
 
-      // Initial starting positions; all blocks are as far left as possible
+      // Backward pass
+      b(blocks,length) = true;
+      for (uint i=length; i-- > 0; )
+        b(blocks,i) = b(blocks,i+1) && !is_black (i);
+      for (uint j=blocks; j-- > 0; )
       {
-        uint d=0;
-        for (uint hint : hints)
+        uint len = hints[j];
+        for (uint i=length; i-- > 0; )
         {
-          starts.push_back(d);
-          d += hint + 1;
+          bool ok = !is_black (i) && b(j,i+1);
+          if (!ok && i + len <= length && no_white (i, i+len))
+          {
+            uint e = i + len;
+            if (j+1 == blocks)
+              ok = b(blocks,e);
+            else
+              ok = e < length && !is_black (e) && b(j+1,e+1);
+          }
+          b(j,i) = ok;
         }
       }
 
-      // Determine maximum start position for each block
+      // Cells which may be white
+      for (uint i=0; i<length; ++i)
+        if (!is_black (i))
+          for (uint j=0; j<=blocks; ++j)
+            if (f(j,i) && b(j,i+1))
+            {
+              set_bit (may_white.data(), i);
+              break;
+            }
+
+      // Cells which may be black: every valid start of every block
+      for (uint j=0; j<blocks; ++j)
       {
-        max_starts.resize(starts.size());
-        uint d = length;
-        uint i = starts.size();
-        do
+        uint len = hints[j];
+        for (uint s=0; s + len <= length; ++s)
         {
-          -- i;
-          d -= hints[i];
-          max_starts[i] = d;
-          d -= 1;
+          uint e = s + len;
+          if (no_white (s, e) == false)
+            continue;
+          bool left = (j == 0) ? f(0,s)
+            : s >= 1 && !is_black (s-1) && f(j,s-1);
+          bool right = (j+1 == blocks) ? b(blocks,e)
+            : e < length && !is_black (e) && b(j+1,e+1);
+          if (left && right)
+          {
+            ++ paint[s];
+            -- paint[e];
+          }
         }
-        while (i > 0);
+      }
+      int depth = 0;
+      for (uint i=0; i<length; ++i)
+      {
+        depth += paint[i];
+        if (depth > 0)
+          set_bit (may_black.data(), i);
       }
 
-      // std::cerr << "max starts:\t";
-      // for (uint ms : max_starts) std::cerr << ms << '\t';
-      // std::cerr << '\n';
+      // A cell is known if it can only be one colour
+      for (uint k=0; k<n_words; ++k)
+      {
+        word mask = ~word(0);
+        if (k+1 == n_words && length % word_bits != 0)
+          mask = (word(1) << (length % word_bits)) - 1;
+        new_black[k] = ~may_white[k] & mask;
+        new_white[k] = ~may_black[k] & mask;
+      }
+      return true;
     }
+  };
 
-    // Fills the row with white, then paints black blocks from each start position
-    void gen_row ()
-    {
-      for (cell & c : row)
-        c = white;
+  // The same decisions for a line of at most MaxLength cells, with every row
+  // of fwd and bwd held in one word, bit i standing for the prefix [0, i) or
+  // the suffix [i, length).  Each row follows from the one before in a few
+  // word operations instead of a loop over the cells, and the storage is
+  // fixed in size, so nothing is allocated.  MaxLength must leave a bit
+  // above the last position spare for the carry in fill().
+  template <uint MaxLength>
+  class nonogram::word_line_solver
+  {
+    static_assert (MaxLength + 2 <= word_bits, "a line must fit in one word");
+    static constexpr uint max_blocks = (MaxLength + 1) / 2;
 
-      // Could benefit from boost::zip_iterator
-      for (uint i=0; i<starts.size(); ++i)
-      {
-        for (uint d=0; d<hints[i]; ++d)
-          row[starts[i]+d] = black;
-      }
+    using rows = std::array<word, max_blocks + 1>;
 
-      row_ready = true;
-    }
+    static word low_bits (uint n)
+    { return (word(1) << n) - 1; }
 
-  public:
-    row_iterator (uint length_, std::vector<uint> const & hints_)
-      : length (length_),
-        hints (hints_)
-    { init(); }
-
-    row_iterator (uint length_, std::vector<uint> && hints_)
-      : length (length_),
-        hints (hints_)
-    { init(); }
-
-    row_iterator (row_iterator const & iter)
-      : length (iter.length),
-        hints (iter.hints),
-        row (iter.row)
-    {}
+    // The lowest n bits of x in reverse order
+    static word reverse (word x, uint n)
+    {
+      x = ((x >> 1) & 0x5555555555555555) | ((x & 0x5555555555555555) << 1);
+      x = ((x >> 2) & 0x3333333333333333) | ((x & 0x3333333333333333) << 2);
+      x = ((x >> 4) & 0x0f0f0f0f0f0f0f0f) | ((x & 0x0f0f0f0f0f0f0f0f) << 4);
+      return __builtin_bswap64 (x) >> (word_bits - n);
+    }
 
-    // Generate row if necessary, then return it
-    std::vector<cell> & operator * ()
+    // Every position reached from a seed by stepping to positions in open:
+    // reach(i) = seeds(i) || (open(i) && reach(i-1)).  This is the carry
+    // chain of (open | seeds) + seeds, where a seed generates a carry and an
+    // open position passes one on.
+    static word fill (word seeds, word open)
     {
-      if (row_ready == false) gen_row();
-      return row;
+      word a = open | seeds;
+      return ((a + seeds) ^ a ^ seeds) >> 1;
     }
 
-    row_iterator & operator ++ ()
+    // Bit s set if the len cells from s are all in cells
+    static word runs (word cells, uint len)
     {
-      // end condition
-      if (starts.front() == max_starts.front())
+      for (uint k=1; k < len; )
       {
-        end = true;
-        return *this;
+        uint step = std::min (k, len - k);
+        cells &= cells >> step;
+        k += step;
       }
+      return cells;
+    }
 
-      // Determine last block which starts below its maximum
-      uint h;
-      for (h = hints.size() - 1; starts[h] == max_starts[h]; --h);
-
-      // ++ starts[h];
-      // uint pos = starts[h] + hints[h] + 1;
-      // for (uint i = h + 1; i < hints.size(); ++i)
-      // 	{
-      // 	  starts[i] =
-      // 	}
-
-      uint s = starts[h] + 1;
-      for ( ; h < hints.size(); ++h)
+    // Bit i set if some bit of starts is in (i - len, i]
+    static word smear (word starts, uint len)
+    {
+      for (uint k=1; k < len; )
       {
-        starts[h] = s;
-        s += hints[h] + 1;
+        uint step = std::min (k, len - k);
+        starts |= starts << step;
+        k += step;
       }
-
-      row_ready = false;
-      return *this;
+      return starts;
     }
 
-    row_iterator operator ++ (int)
-    { row_iterator temp (*this); ++(*this); return temp; }
-
-    bool operator == (row_iterator iter) const
-    { return !(*this != iter); }
-
-    bool operator != (row_iterator iter) const
+    // fwd[j] for j = 0..blocks, the blocks taken in order or reversed
+    static void forward (word black, word white, uint length, std::vector<uint> const & hints,
+                         bool reversed, rows & fwd)
     {
-      if (end != iter.end)       return true;
-      if (hints != iter.hints)   return true;
-      if (starts != iter.starts) return true;
-      return false;
-    }
-
-    bool done () const
-    { return end; }
-  };
-
-  std::vector<nonogram::cell> nonogram::work_row (std::vector<cell> const & known, std::vector<uint> const & hints)
-  {
-    std::vector<std::vector<cell>> possible_results;
-
-    auto consistent = [] (std::vector<cell> const & test, std::vector<cell> const & reference)
+      uint blocks = hints.size();
+      word not_black = (~black & low_bits (length)) << 1;   // position i: cell i-1 not black
+      word not_white = ~white & low_bits (length);
+      fwd[0] = fill (1, not_black);
+      for (uint j=1; j<=blocks; ++j)
       {
-        for (uint i=0; i < test.size(); ++i)
-        {
-          if (reference[i] != open)
-            if (test[i] != reference[i])
-              return false;
-        }
-        return true;
-      };
-
-    row_iterator iter (known.size(), hints);
-    while (iter.done() == false)
-    {
-      if (consistent(*iter, known))
-        possible_results.push_back(*iter);
-      ++ iter;
+        uint len = hints[reversed ? blocks - j : j - 1];
+        word left = (j == 1) ? fwd[0] : (fwd[j-1] << 1) & not_black;
+        fwd[j] = fill ((left & runs (not_white, len)) << len, not_black);
+      }
     }
 
-    std::vector<cell> result (known.size());
-    for (uint i=0; i < known.size(); ++i)
+  public:
+    static bool solve (word const * known_black, word const * known_white, uint length,
+                       std::vector<uint> const & hints, word * new_black, word * new_white)
     {
-      cell c = possible_results.front()[i];
-      for (uint r=1; c != open && r < possible_results.size(); ++r)
+      uint blocks = hints.size();
+      if (blocks > max_blocks)   // more blocks than could fit
+        return false;
+
+      word cells = low_bits (length);
+      word black = known_black[0] & cells, white = known_white[0] & cells;
+      rows fwd, bwd, rev;
+      forward (black, white, length, hints, false, fwd);
+      if (((fwd[blocks] >> length) & 1) == 0)
+        return false;
+
+      // bwd is fwd of the reversed line, with position i at length - i
+      forward (reverse (black, length), reverse (white, length), length, hints, true, rev);
+      for (uint j=0; j<=blocks; ++j)
+        bwd[j] = reverse (rev[blocks - j], length + 1);
+
+      word not_black = ~black & cells;
+      word not_white = ~white & cells;
+      word may_white = 0, may_black = 0;
+      for (uint j=0; j<=blocks; ++j)
+        may_white |= fwd[j] & (bwd[j] >> 1);
+      may_white &= not_black;
+
+      for (uint j=0; j<blocks; ++j)
       {
-        if (possible_results[r][i] != c)
-          c = open;
+        uint len = hints[j];
+        word left = (j == 0) ? fwd[0] : (fwd[j] << 1) & (not_black << 1);   // as in forward()
+        word right = (j+1 == blocks) ? bwd[blocks] : (bwd[j+1] >> 1) & not_black;
+        word starts = left & runs (not_white, len) & (right >> len);
+        may_black |= smear (starts, len);
       }
-      result[i] = c;
+
+      new_black[0] = ~may_white & cells;
+      new_white[0] = ~may_black & cells;
+      return true;
     }
-    return result;
+  };
+
+  bool nonogram::work_row (word const * black, word const * white, uint length, std::vector<uint> const & hints,
+                           word * new_black, word * new_white)
+  {
+    // The scratch buffers are kept between calls, one set per thread
+    static thread_local line_solver solver;
+    static thread_local std::vector<word> key;
+
+    // Lines of the usual sizes go to a kernel fixed at compile time for the
+    // next size up; longer ones to the general solver
+    auto solve = [&] ()
+    {
+      if (length <= 5)
+        return word_line_solver<5>::solve (black, white, length, hints, new_black, new_white);
+      if (length <= 10)
+        return word_line_solver<10>::solve (black, white, length, hints, new_black, new_white);
+      if (length <= 15)
+        return word_line_solver<15>::solve (black, white, length, hints, new_black, new_white);
+      if (length <= 20)
+        return word_line_solver<20>::solve (black, white, length, hints, new_black, new_white);
+      if (length <= 25)
+        return word_line_solver<25>::solve (black, white, length, hints, new_black, new_white);
+      if (length <= 30)
+        return word_line_solver<30>::solve (black, white, length, hints, new_black, new_white);
+      if (length <= 50)
+        return word_line_solver<50>::solve (black, white, length, hints, new_black, new_white);
+      return solver.solve (black, white, length, hints, new_black, new_white);
+    };
+
+    if (cache == nullptr)
+      return solve ();
+
+    uint n_words = words (length);
+    bool consistent;
+    line_cache::make_key (key, length, hints, black, white, n_words);
+    if (cache -> find (key, consistent, new_black, new_white, n_words))
+      return consistent;
+
+    consistent = solve ();
+    cache -> insert (key, consistent, new_black, new_white, n_words);
+    return consistent;
   }
 }
 
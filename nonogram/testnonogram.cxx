@@ -1,12 +1,96 @@
 #include "nonogram.hxx"
+#include "../common/batch.hxx"
 
+#include <cstdlib>
 #include <iostream>
+#include <memory>
+#include <string>
 
-int main ()
+void print_result (std::ostream & os, ad::nonogram const & ng, ad::nonogram::result r)
 {
+  switch (r)
+  {
+  case ad::nonogram::solved:
+    os << ng;
+    break;
+  case ad::nonogram::multiple:
+    os << "more than one solution was found; one of them is:\n" << ng;
+    break;
+  case ad::nonogram::none:
+    os << "no solution.\n";
+    break;
+  }
+}
+
+int main (int argc, char ** argv)
+{
+  std::unique_ptr<ad::line_cache> cache;
+  uint threads = 1;
+  bool batch = false;
+  std::string input_path;
+  bool metrics = false;
+
+  // -j N solves lines on N threads, or in batch mode N puzzles at once
+  // -c N caches up to N line solutions
+  // -b solves every puzzle in the input, one after another
+  // -i FILE reads the batch from a file instead of stdin
+  // -m writes the solver's metrics to stderr as JSON
+  for (int a=1; a < argc; ++a)
+    if (std::string(argv[a]) == "-j" && a+1 < argc)
+      threads = std::atoi (argv[++a]);
+    else if (std::string(argv[a]) == "-c" && a+1 < argc)
+      cache = std::make_unique<ad::line_cache> (std::atoi (argv[++a]));
+    else if (std::string(argv[a]) == "-b")
+      batch = true;
+    else if (std::string(argv[a]) == "-i" && a+1 < argc)
+      input_path = argv[++a];
+    else if (std::string(argv[a]) == "-m")
+      metrics = true;
+
+  if (batch)
+  {
+    ad::scanner in;
+    if (input_path.empty() ? in.read_all (0) == false : in.open (input_path) == false)
+    {
+      std::cerr << "cannot read " << (input_path.empty() ? "stdin" : input_path) << ".\n";
+      return 1;
+    }
+    ad::thread_pool pool (threads);
+    bool ok = ad::run_batch<ad::nonogram> (in, pool, std::cout, [&] (ad::nonogram & ng, std::ostream & os)
+    {
+      ng.use_cache (cache.get());
+      print_result (os, ng, ng.solve());
+    });
+    return ok ? 0 : 1;
+  }
+
   ad::nonogram ng;
+  ng.set_threads (threads);
+  ng.use_cache (cache.get());
 
   std::cin >> ng;
-  ng.solve();
-  std::cout << ng;
+  ad::nonogram::result r = ng.solve();
+
+  std::cerr << ng.line_solve_count() << " line solves";
+  if (ng.probe_count() != 0)
+    std::cerr << ", " << ng.probe_count() << " probes, " << ng.branch_count() << " branches";
+  std::cerr << '\n';
+
+  print_result (std::cout, ng, r);
+
+  if (cache)
+    std::cerr << "line cache: " << cache -> hits() << " hits, " << cache -> misses() << " misses ("
+              << int (100 * cache -> hit_rate()) << "%), " << cache -> evictions() << " evictions\n";
+
+  if (metrics)
+  {
+    ad::json_writer j (std::cerr);
+    ng.write_metrics (j);
+    if (cache)
+      j.begin ("line_cache")
+        .field ("hits", std::uint64_t (cache -> hits()))
+        .field ("misses", std::uint64_t (cache -> misses()))
+        .field ("evictions", std::uint64_t (cache -> evictions()))
+        .end();
+  }
 }
@@ -1,76 +1,57 @@
+#include "strata.hxx"
+#include "../common/batch.hxx"
+
+#include <cstdlib>
 #include <iostream>
-#include <sstream>
-#include <stack>
+#include <string>
 #include <vector>
 
-int main ()
+void print_solution (std::ostream & os, ad::strata::puzzle const & p)
 {
-	uint n_rows, n_cols;
-	std::cin >> n_rows >> n_cols;
-	std::vector<std::vector<char>> grid (n_rows, std::vector<char>(n_cols, '.'));
-	std::stack<std::string> solution;
-	std::vector<bool> solved_row (n_rows, false);
-	std::vector<bool> solved_col (n_cols, false);
+	std::vector<ad::strata::step> solution;
+	if (ad::strata::solve(p, solution) == false)
+	{
+		os << "no solution.\n";
+		return;
+	}
 
-	for (uint row = 0; row != n_rows; ++row)
-		for (uint col = 0; col != n_cols; ++col)
-			std::cin >> grid[row][col];
+	for (ad::strata::step const & s : solution)
+		os << s << '\n';
+}
 
-	while (solution.size() != n_rows + n_cols)
-	{
-		// Iterate over rows
-		for (uint row = 0; row != n_rows; ++row)
-			if (solved_row[row] == false)
-			{
-				char c = '.';
-				// If the row contains at most one colour
-				// As a side effect, c will contain the value of that colour
-				// I realize how lispy this is.
-				if ([&] () {
-						for (uint col = 0; col != n_cols; ++col)
-							if (c == '.')
-								c = grid[row][col];
-							else
-								if (grid[row][col] != '.' && grid[row][col] != c) return false;
-						return true;
-					}())
-				{
-					std::stringstream ss;
-					ss << "Row " << row << ": " << c;
-					solution.push(ss.str());
-					for (uint col = 0; col != n_cols; ++col)
-						grid[row][col] = '.';
-					solved_row[row] = true;
-				}
-			}
+int main (int argc, char ** argv)
+{
+	// -b solves every grid in the input, one after another
+	// -j N solves N grids of a batch at once
+	// -i FILE reads the batch from a file instead of stdin
+	bool batch = false;
+	int threads = 1;
+	std::string input_path;
+	for (int a=1; a < argc; ++a)
+		if (std::string(argv[a]) == "-b")
+			batch = true;
+		else if (std::string(argv[a]) == "-j" && a+1 < argc)
+			threads = std::atoi(argv[++a]);
+		else if (std::string(argv[a]) == "-i" && a+1 < argc)
+			input_path = argv[++a];
 
-		// Same thing over columns
-		for (uint col = 0; col != n_cols; ++col)
-			if (solved_col[col] == false)
-			{
-				char c = '.';
-				if ([&] () {
-						for (uint row = 0; row != n_rows; ++row)
-							if (c == '.')
-								c = grid[row][col];
-							else
-								if (grid[row][col] != '.' && grid[row][col] != c) return false;
-						return true;
-					}())
-				{
-					std::stringstream ss;
-					ss << "Col " << col << ": " << c;
-					solution.push(ss.str());
-					for (uint row = 0; row != n_rows; ++row)
-						grid[row][col] = '.';
-					solved_col[col] = true;
-				}
-			}
-	}
+	std::ios::sync_with_stdio(false);
 
-	while (solution.empty() == false)
+	if (batch)
 	{
-		std::cout << solution.top() << '\n';
-		solution.pop();
+		ad::scanner in;
+		if (input_path.empty() ? in.read_all(0) == false : in.open(input_path) == false)
+		{
+			std::cerr << "cannot read " << (input_path.empty() ? "stdin" : input_path) << ".\n";
+			return 1;
+		}
+		ad::thread_pool pool (threads);
+		bool ok = ad::run_batch<ad::strata::puzzle>(in, pool, std::cout,
+			[] (ad::strata::puzzle const & p, std::ostream & os) { print_solution(os, p); });
+		return ok ? 0 : 1;
 	}
+
+	ad::strata::puzzle p;
+	std::cin >> p;
+	print_solution(std::cout, p);
 }
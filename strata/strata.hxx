@@ -0,0 +1,176 @@
+#ifndef AD_STRATA_HXX
+#define AD_STRATA_HXX
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+namespace ad::strata
+{
+	// A grid of coloured cells, '.' for a cell with no colour
+	struct puzzle
+	{
+		unsigned n_rows = 0, n_cols = 0;
+		std::vector<char> grid;   // row by row
+
+		char at (unsigned row, unsigned col) const
+		{ return grid[row * n_cols + col]; }
+	};
+
+	// Reads from a std::istream or an ad::scanner
+	template <typename Input>
+	Input & operator >> (Input & is, puzzle & p)
+	{
+		is >> p.n_rows >> p.n_cols;
+		p.grid.assign(std::size_t(p.n_rows) * p.n_cols, '.');
+		for (char & c : p.grid)
+			is >> c;
+		return is;
+	}
+
+	// Laying the ribbon over a row or column, in the colour it is given
+	struct step
+	{
+		bool row;
+		unsigned index;
+		char colour;
+	};
+
+	std::ostream & operator << (std::ostream & os, step const & s)
+	{
+		return os << (s.row ? "Row " : "Col ") << s.index << ": " << s.colour;
+	}
+
+	// Works backwards from the finished grid: a line whose remaining cells
+	// are all one colour can have been laid last, so it is peeled off and its
+	// cells no longer count.  Each line keeps a count of its remaining cells
+	// of each colour, and of how many colours it has left; peeling a line
+	// updates the counts of the lines crossing it, and queues any that are
+	// down to one colour.  Every cell is uncounted at most twice, so the work
+	// is linear in the size of the grid.
+	//
+	// The rows ready at once are peeled in order, then the columns, and so
+	// on, as a pass over all rows then all columns would.  Fills steps with
+	// the order to lay the ribbons in, or returns false if the grid cannot be
+	// made.
+	bool solve (puzzle const & p, std::vector<step> & steps)
+	{
+		unsigned const n_rows = p.n_rows, n_cols = p.n_cols;
+
+		// Number the colours
+		int colour_index[256];
+		std::fill(colour_index, colour_index + 256, -1);
+		std::vector<char> colours;
+		std::vector<std::uint8_t> cell_colour (p.grid.size());
+		for (std::size_t i=0; i != p.grid.size(); ++i)
+		{
+			unsigned char c = p.grid[i];
+			if (c == '.')
+				continue;
+			if (colour_index[c] < 0)
+			{
+				colour_index[c] = colours.size();
+				colours.push_back(c);
+			}
+			cell_colour[i] = colour_index[c];
+		}
+		std::size_t const n_colours = colours.size();
+
+		auto live = [&] (std::size_t i) { return p.grid[i] != '.'; };
+
+		std::vector<std::uint32_t> row_count (n_rows * n_colours, 0), col_count (n_cols * n_colours, 0);
+		std::vector<unsigned> row_colours (n_rows, 0), col_colours (n_cols, 0);
+		for (unsigned row = 0; row != n_rows; ++row)
+			for (unsigned col = 0; col != n_cols; ++col)
+			{
+				std::size_t i = std::size_t(row) * n_cols + col;
+				if (live(i) == false)
+					continue;
+				if (row_count[row * n_colours + cell_colour[i]]++ == 0)
+					++row_colours[row];
+				if (col_count[col * n_colours + cell_colour[i]]++ == 0)
+					++col_colours[col];
+			}
+
+		std::vector<bool> row_peeled (n_rows, false), col_peeled (n_cols, false);
+		std::vector<bool> row_queued (n_rows, false), col_queued (n_cols, false);
+		std::vector<unsigned> ready_rows, ready_cols;
+		for (unsigned row = 0; row != n_rows; ++row)
+			if (row_colours[row] <= 1)
+			{
+				ready_rows.push_back(row);
+				row_queued[row] = true;
+			}
+		for (unsigned col = 0; col != n_cols; ++col)
+			if (col_colours[col] <= 1)
+			{
+				ready_cols.push_back(col);
+				col_queued[col] = true;
+			}
+
+		// The colour left in a line, or '.' if it has none
+		auto remaining = [&] (std::vector<std::uint32_t> const & count, unsigned line)
+		{
+			for (std::size_t k=0; k != n_colours; ++k)
+				if (count[line * n_colours + k] != 0)
+					return colours[k];
+			return '.';
+		};
+
+		steps.clear();
+		std::vector<unsigned> batch;
+		while (steps.size() != n_rows + n_cols)
+		{
+			if (ready_rows.empty() && ready_cols.empty())
+				return false;
+
+			batch.swap(ready_rows);
+			std::sort(batch.begin(), batch.end());
+			for (unsigned row : batch)
+			{
+				steps.push_back(step {true, row, remaining(row_count, row)});
+				row_peeled[row] = true;
+				for (unsigned col = 0; col != n_cols; ++col)
+				{
+					std::size_t i = std::size_t(row) * n_cols + col;
+					if (col_peeled[col] || live(i) == false)
+						continue;
+					if (--col_count[col * n_colours + cell_colour[i]] == 0
+					    && --col_colours[col] <= 1 && col_queued[col] == false)
+					{
+						ready_cols.push_back(col);
+						col_queued[col] = true;
+					}
+				}
+			}
+			batch.clear();
+
+			batch.swap(ready_cols);
+			std::sort(batch.begin(), batch.end());
+			for (unsigned col : batch)
+			{
+				steps.push_back(step {false, col, remaining(col_count, col)});
+				col_peeled[col] = true;
+				for (unsigned row = 0; row != n_rows; ++row)
+				{
+					std::size_t i = std::size_t(row) * n_cols + col;
+					if (row_peeled[row] || live(i) == false)
+						continue;
+					if (--row_count[row * n_colours + cell_colour[i]] == 0
+					    && --row_colours[row] <= 1 && row_queued[row] == false)
+					{
+						ready_rows.push_back(row);
+						row_queued[row] = true;
+					}
+				}
+			}
+			batch.clear();
+		}
+
+		std::reverse(steps.begin(), steps.end());
+		return true;
+	}
+}
+
+#endif